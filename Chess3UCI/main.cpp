@@ -2,7 +2,6 @@
 #include <fstream>
 #include <string>
 #include <vector>
-#include <list>
 #include <algorithm>
 #include <condition_variable>
 
@@ -15,22 +14,27 @@ class Bot {
 private:
     Gigantua::Board board;
     Search::Ant::Engine antEngine;
-    std::list<uint64_t> history;
+    std::array<uint64_t, 16> history = {}; // most recent first, only the last 15 positions reach the search
 
 public:
-    Bot(std::function<float(const Gigantua::Board&)> costFunc) : board(Gigantua::Board::StartPositionFen())
-        , antEngine(costFunc, 2000000)
+    Bot(std::function<float(const Gigantua::Board&)> costFunc, Search::EvalStackFactory evalFactory) : board(Gigantua::Board::StartPositionFen())
+        , antEngine(costFunc, 2000000, 4000000, evalFactory)
     {
     }
 
     void NotifyNewGame() {
-        history.clear();
+        antEngine.NewGame();
         SetPosition(Gigantua::Board::StartPositionFen());
     }
 
     void SetPosition(const std::string& fen) {
         board = Gigantua::Board(fen); 
-        history.clear();
+        history.fill(0);
+    }
+
+    void PushHistory(uint64_t hash) {
+        std::copy_backward(history.begin(), history.end() - 1, history.end());
+        history[0] = hash;
     }
 
     void MakeMove(const std::string& moveStr) {
@@ -57,7 +61,7 @@ public:
             }
             if (moveW.move) {
                 board = moveW.play(board);
-                history.push_front(board.Hash);
+                PushHistory(board.Hash);
             }
         }
         else {
@@ -79,7 +83,7 @@ public:
             }
             if (moveB.move) {
                 board = moveB.play(board);
-                history.push_front(board.Hash);
+                PushHistory(board.Hash);
             }
         }
     }
@@ -97,14 +101,8 @@ public:
         };
 
         antEngine.Set(board);
-        std::array<uint64_t, 16> h = { 0 };
-        {
-            uint8_t i = 0;
-            for (uint64_t hash : history) {
-                h[i++] = hash;
-                if (i + 1 >= h.size()) break;
-            }
-        }
+        std::array<uint64_t, 16> h = history;
+        h.back() = 0;
         antEngine.SetHistory(h);
         antEngine.Start(4, 4, timeMs, onDone);
 
@@ -175,7 +173,7 @@ private:
     static std::vector<std::string> goLabels;
 
 public:
-    EngineUCI(std::function<float(const Gigantua::Board&)> costFunc) : player(costFunc) {
+    EngineUCI(std::function<float(const Gigantua::Board&)> costFunc, Search::EvalStackFactory evalFactory) : player(costFunc, evalFactory) {
     }
 
     void ReceiveCommand(const std::string& message) {
@@ -204,15 +202,15 @@ private:
             player.SetPosition(customFen);
         }
 
+        // Moves are at most 6 chars ("e7e8=q") so every token stays in the small string buffer
         std::string moves = TryGetLabelledValue(message, "moves", positionLabels);
-        if (!moves.empty()) {
-            std::istringstream iss(moves);
-            std::string move;
-
-            while (iss >> move) {
-                move.erase(std::remove(move.begin(), move.end(), '='), move.end());
-                player.MakeMove(move);
-            }
+        std::string move;
+        for (size_t pos = moves.find_first_not_of(" \t"); pos != std::string::npos; ) {
+            const size_t end = std::min(moves.find_first_of(" \t", pos), moves.size());
+            move.assign(moves, pos, end - pos);
+            move.erase(std::remove(move.begin(), move.end(), '='), move.end());
+            player.MakeMove(move);
+            pos = moves.find_first_not_of(" \t", end);
         }
     }
 
@@ -285,34 +283,27 @@ private:
 std::vector<std::string> EngineUCI::positionLabels = { "position", "fen", "moves" };
 std::vector<std::string> EngineUCI::goLabels = { "go", "movetime", "wtime", "btime", "winc", "binc", "movestogo" };
 
-std::vector<float> importNet(const std::string& fileName) {
-    std::vector<float> genome;
-    std::fstream file;
-    file.open(fileName, std::ios::in);
-
-    if (file.is_open()) {
-        std::string line;
-        size_t i = 0;
-        while (std::getline(file, line)) {
-            genome.push_back(std::stof(line));
-        }
-
-        file.close();
+int main(int argc, char** argv) {
+    // --simd sse4.1|avx2|avx512vnni forces the network kernels, by default the best supported level is used
+    for (int i = 1; i + 1 < argc; i++) {
+        if (std::string(argv[i]) == "--simd" && !NN::Simd::Force(argv[i + 1]))
+            std::cerr << "simd level " << argv[i + 1] << " not supported, using " << NN::Simd::LevelStr(NN::Simd::Active()) << std::endl;
     }
 
-    return genome;
-}
-
-int main() {
-    const std::vector<float> gen = importNet("genome0.txt");
     NN::NeuroNetEval nne;
-    nne.SetGenome(gen);
-   
+    if (nne.LoadOrRead("genome0.bin", "genome0.txt", 64, std::cerr) != NN::NetFile::Error::None) return 1;
+
     std::function<float(const Gigantua::Board&)> costFunc = [&nne](const Gigantua::Board& pos) {
         return nne.Evaluate(pos);
      };
 
-    EngineUCI engine(costFunc);
+    //Search threads keep the first layer incrementally along their path
+    Search::EvalStackFactory evalFactory = [&nne]() {
+        return std::make_shared<Search::AccumulatorEvalStack<NN::NeuroNetEval>>(nne);
+    };
+
+    EngineUCI engine(costFunc, evalFactory);
+    std::cerr << "hash tables on " << LargePages::KindStr(LargePages::Obtained()) << std::endl;
     std::string command;
 
     std::ofstream log("log.txt", std::ios::app);
@@ -3,12 +3,16 @@
 #include <cstring>
 #include <fstream>
 #include <algorithm>
+#include <optional>
+#include <random>
 
 
 #include "../Search/AlphaBetaSearch.hpp"
 #include "../Search/AntSearch.hpp"
 
 #include "../Eval/NeuroNetEval.hpp"
+#include "../Search/EvalStack.hpp"
+#include "../Gigantua/ChessTest.hpp"
 
 struct MoveStr
 {
@@ -92,10 +96,175 @@ std::vector<float> importNet(const std::string& fileName) {
 	return genome;
 }
 
-int main() {
-	const std::vector<float> gen = importNet("genome0.txt");
+//Evaluations per second of the scalar reference, the SIMD transformer with the dense and the sparse first hidden
+//layer for every supported SIMD level and the incremental accumulator over the test positions and all their children
+template<bool white>
+void evalBenchChildren(const Gigantua::Board& brd, std::vector<std::pair<Gigantua::Board, Gigantua::Board>>& out) {
+	for (const auto& move : Gigantua::MoveList::MoveList<white>(brd)) {
+		out.emplace_back(brd, move.play(brd));
+	}
+}
+
+void evalBench(NN::NeuroNetOpt& nn, NN::NeuroNetEval& nne) {
+	std::vector<std::pair<Gigantua::Board, Gigantua::Board>> positions; //parent, child
+	for (const auto& pos : Test::Positions) {
+		const Gigantua::Board brd(Test::GetElements(pos, ';')[0]);
+		if (brd.status.WhiteMove()) evalBenchChildren<true>(brd, positions);
+		else evalBenchChildren<false>(brd, positions);
+	}
+
+	constexpr size_t Rounds = 200;
+	const auto run = [&](const char* name, auto&& evaluate) {
+		int64_t sum = 0;
+		const auto start = std::chrono::high_resolution_clock::now();
+		for (size_t r = 0; r < Rounds; r++) {
+			for (const auto& p : positions) sum += evaluate(p.first, p.second);
+		}
+		const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start).count();
+		std::cout << name << ": " << (Rounds * positions.size() * 1000) / std::max<int64_t>(ms, 1) << " evals/s (" << ms << "ms, sum " << sum << ")" << std::endl;
+		return sum;
+	};
+
+	const NN::Simd::Level active = NN::Simd::Active();
+	const int64_t ref = run("reference", [&](const Gigantua::Board&, const Gigantua::Board& brd) { return nn.EvaluateReference(brd); });
+
+	size_t mismatches = 0;
+	bool sumsMatch = true;
+	for (uint8_t level = 0; level <= uint8_t(NN::Simd::Detected()); level++) {
+		NN::Simd::Force(NN::Simd::Level(level));
+		for (bool sparse : { false, true }) {
+			nn.mSparseInput = sparse;
+			for (const auto& p : positions) {
+				if (nn.Evaluate(p.second) != nn.EvaluateReference(p.second)) mismatches++;
+			}
+
+			const std::string name = std::string(NN::Simd::LevelStr(NN::Simd::Level(level))) + (sparse ? " full sparse" : " full dense");
+			sumsMatch &= ref == run(name.c_str(), [&](const Gigantua::Board&, const Gigantua::Board& brd) { return nn.Evaluate(brd); });
+		}
+	}
+	NN::Simd::Force(active);
+
+	Search::AccumulatorEvalStack<NN::NeuroNetEval> stack(nne);
+	std::optional<Gigantua::Board> root;
+	sumsMatch &= ref == run((std::string(NN::Simd::LevelStr(active)) + " incremental").c_str(), [&](const Gigantua::Board& parent, const Gigantua::Board& brd) {
+		if (!root || !(*root == parent)) {//children of one parent are adjacent
+			root = parent;
+			stack.Reset(parent);
+			stack.Evaluate(parent);
+		}
+		stack.Push(brd);
+		const int64_t eval = int64_t(stack.Evaluate(brd));
+		stack.Pop();
+		return eval;
+	});
+
+	std::cout << positions.size() << " positions, " << mismatches << " mismatches" << std::endl;
+	if (!sumsMatch || mismatches) std::cout << "eval bench ERROR!" << std::endl;
+}
+
+//Random games with take backs: after every move the accumulator stack has to give exactly the full evaluation.
+//Half the games evaluate rarely, so the stack replays several plies at once or refreshes after a long stretch.
+//The walk also has to go through king moves (a new bucket each with 64), king moves across the board middle
+//(a mirrored side with 32), castling and promotions - a walk that never did one of them fails
+struct WalkCounts {
+	size_t evals = 0;
+	size_t mismatches = 0;
+	size_t kingMoves = 0;
+	size_t crossings = 0;
+	size_t castles = 0;
+	size_t promotions = 0;
+};
+
+template<bool white>
+bool walkMove(std::vector<Gigantua::Board>& path, std::mt19937& rng, WalkCounts& counts) {
+	const Gigantua::Board& brd = path.back();
+	const auto moves = Gigantua::MoveList::MoveList<white>(brd);
+	if (moves.empty()) return false;
+	const Gigantua::Board next = moves[rng() % moves.size()].play(brd);
+
+	const uint64_t kingBefore = white ? brd.WKing : brd.BKing;
+	const uint64_t kingAfter = white ? next.WKing : next.BKing;
+	if (kingBefore != kingAfter) {
+		counts.kingMoves++;
+		counts.crossings += (SquareOf(kingBefore) & 7) / 4 != (SquareOf(kingAfter) & 7) / 4;
+		counts.castles += (white ? brd.WRook != next.WRook : brd.BRook != next.BRook);
+	}
+	counts.promotions += (white ? Bitcount(brd.WPawn) > Bitcount(next.WPawn) : Bitcount(brd.BPawn) > Bitcount(next.BPawn));
+	path.push_back(next);
+	return true;
+}
+
+bool accumulatorWalk(NN::NeuroNetEval& nne) {
+	const char* starts[] = {
+		"r3k2r/1P4P1/8/8/8/8/1p4p1/R3K2R w KQkq - 0 1",
+		"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+		"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+		"4k3/3p4/8/8/8/8/4P3/4K3 w - - 0 1",
+	};
+	constexpr size_t Games = 40;
+	constexpr size_t Steps = 150;
+	constexpr size_t MaxDepth = 60;
+
+	Search::AccumulatorEvalStack<NN::NeuroNetEval> stack(nne);
+	std::mt19937 rng(20260917);
+	WalkCounts counts;
+	for (const char* fen : starts) {
+		for (size_t game = 0; game < Games; game++) {
+			const uint32_t evalEvery = game % 2 ? 12 : 1;
+			std::vector<Gigantua::Board> path{ Gigantua::Board(fen) };
+			stack.Reset(path.back());
+			for (size_t step = 0; step < Steps; step++) {
+				const bool takeBack = path.size() > 1 && (rng() % 4 == 0 || path.size() > MaxDepth);
+				if (!takeBack && (path.back().status.WhiteMove() ? walkMove<true>(path, rng, counts) : walkMove<false>(path, rng, counts))) {
+					stack.Push(path.back());
+				}
+				else if (path.size() > 1) {
+					path.pop_back();
+					stack.Pop();
+				}
+				else break;
+
+				if (rng() % evalEvery) continue;
+				counts.evals++;
+				if (stack.Evaluate(path.back()) != nne.Evaluate(path.back())) counts.mismatches++;
+			}
+		}
+	}
+
+	std::cout << nne.m_nn.mKingBuckets << " buckets: " << counts.evals << " evals, " << counts.kingMoves << " king moves, " << counts.crossings << " across the middle, "
+		<< counts.castles << " castles, " << counts.promotions << " promotions, " << counts.mismatches << " mismatches" << std::endl;
+	return counts.mismatches == 0 && counts.kingMoves && counts.crossings && counts.castles && counts.promotions;
+}
+
+int main(int argc, char** argv) {
+	bool evalBenchOnly = false;
+	uint32_t kingBuckets = 64;
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--evalbench") == 0) evalBenchOnly = true;
+		else if (std::strcmp(argv[i], "--buckets") == 0 && i + 1 < argc) kingBuckets = std::strcmp(argv[++i], "32") == 0 ? 32 : 64;
+		else if (std::strcmp(argv[i], "--simd") == 0 && i + 1 < argc) {
+			if (!NN::Simd::Force(argv[++i])) std::cout << "simd level " << argv[i] << " not supported" << std::endl;
+		}
+	}
+	std::cout << "simd: " << NN::Simd::LevelStr(NN::Simd::Active()) << " (detected " << NN::Simd::LevelStr(NN::Simd::Detected()) << ")" << std::endl;
+
 	NN::NeuroNetEval nne;
-	nne.SetGenome(gen);
+	if (nne.LoadOrRead("genome0.bin", "genome0.txt", kingBuckets, std::cout) != NN::NetFile::Error::None) return 1;
+	std::cout << "king buckets: " << nne.m_nn.mKingBuckets << std::endl;
+
+	if (evalBenchOnly) {
+		NN::NeuroNetOpt nn;
+		if (nn.LoadOrRead("genome0.bin", "genome0.txt", kingBuckets, std::cout) != NN::NetFile::Error::None) return 1;
+		evalBench(nn, nne);
+
+		//Both bucket layouts, the one not asked for is read from the genome text unless genome0.bin has it
+		NN::NeuroNetEval other;
+		if (other.LoadOrRead("genome0.bin", "genome0.txt", kingBuckets == 64 ? 32 : 64, std::cout) != NN::NetFile::Error::None) return 1;
+		bool walkOk = accumulatorWalk(nne);
+		walkOk &= accumulatorWalk(other);
+		std::cout << (walkOk ? "accumulator walk test OK" : "accumulator walk test ERROR!") << std::endl;
+		return 0;
+	}
 
 	//Gigantua::Board p("8/8/7K/8/5Q1P/3k4/8/8 w - - 0 0");
 	//Gigantua::Board p("8/8/8/6K1/5Q1P/2k5/8/8 w - - 2 2");
@@ -123,6 +292,7 @@ int main() {
 	};
 
 	Search::Ant::Engine engine(nsCostFunc, 2000000);
+	std::cout << "hash tables on " << LargePages::KindStr(LargePages::Obtained()) << std::endl;
 	uint32_t timeMs = 300 * 1000;
 
 	uint16_t winMove = 0;
@@ -152,5 +322,8 @@ int main() {
 		std::cout << "bestmove " << Gigantua::Board::moveStr(bestMove) << " " << kkk << std::endl;
 	}
 
+	const auto tt = engine.AbEngine().TTStats();
+	std::cout << "ab nodes " << engine.AbEngine().Nodes() << ", tt probes " << tt.probes << " hits " << tt.hits << " cutoffs " << tt.cutoffs << " overwrites " << tt.overwrites << std::endl;
+
 	return 0;
 }
\ No newline at end of file
@@ -11,8 +11,28 @@ namespace NN
 	public:
 		NeuroNetOpt m_nn;
 
-		void SetGenome(const std::vector<float>& genome) {
-			m_nn.SetGenome(genome);
+		//kingBuckets 32 folds the 64 bucket genome into horizontally mirrored buckets - half the first layer
+		NetFile::Error SetGenome(const std::vector<float>& genome, uint32_t kingBuckets = 64) {
+			return m_nn.SetGenome(genome, kingBuckets);
+		}
+
+		//Binary net written by NetConvert - see NeuroNetFile.hpp. Refused as Stale when sourcePath is a different genome
+		NetFile::Error Load(const char* path, const char* sourcePath = nullptr) {
+			return m_nn.Load(path, sourcePath);
+		}
+
+		//genome0.bin if it is current, else genome0.txt - see NeuroNetOpt::LoadOrRead
+		NetFile::Error LoadOrRead(const char* binPath, const char* textPath, uint32_t kingBuckets, std::ostream& log) {
+			return m_nn.LoadOrRead(binPath, textPath, kingBuckets, log);
+		}
+
+		NetFile::Error Save(const char* path, const NetFile::Source& source = {}) const {
+			return m_nn.Save(path, source);
+		}
+
+		//Sparse or dense first hidden layer - same results, speed depends on the hardware
+		void SetSparseInput(bool sparse) {
+			m_nn.mSparseInput = sparse;
 		}
 
 		static float EvaluateMaterial(const Gigantua::Board& brd)
@@ -79,7 +99,29 @@ namespace NN
 
 		float Evaluate(const Gigantua::Board& brd)
 		{
-			float nnEval = m_nn.Evaluate(brd);
+			return Correct(brd, float(m_nn.Evaluate(brd)));
+		}
+
+		//Incremental interface used by Search::AccumulatorEvalStack
+		using Accumulator = NeuroNetOpt::Accumulator;
+		using RefreshCache = NeuroNetOpt::RefreshCache;
+
+		void Refresh(Accumulator& acc, const Gigantua::Board& brd, RefreshCache& cache) {
+			m_nn.Refresh(acc, brd, cache);
+		}
+
+		void Update(const Accumulator& prev, Accumulator& next, const Gigantua::Board& before, const Gigantua::Board& after, RefreshCache& cache) {
+			m_nn.Update(prev, next, before, after, cache);
+		}
+
+		float Evaluate(const Gigantua::Board& brd, const Accumulator& acc)
+		{
+			return Correct(brd, float(m_nn.Evaluate(brd, acc)));
+		}
+
+	private:
+		static float Correct(const Gigantua::Board& brd, float nnEval)
+		{
 			if(abs(nnEval) > 2200) {
 				const float matEval = 2.0f*(EvaluateMaterial(brd) + EvaluateQueenKingMate(brd));
 				nnEval += brd.status.WhiteMove() ? matEval : -matEval;
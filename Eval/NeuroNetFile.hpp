@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <../Gigantua/MappedFile.hpp>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace NN
+{
+	//Binary network file: a 128 byte header followed by the quantized and permuted tensors exactly as NeuroNetOpt keeps
+	//them in memory, so loading is a mmap plus a checksum. Little endian only - the kernels are x86 anyway.
+	//The header records size and checksum of the genome text the net was converted from, so a file left behind by an
+	//older genome is noticed. Bump Version whenever the quantization or the tensor layout changes
+	namespace NetFile {
+
+		static constexpr char Magic[8] = { 'C', '3', 'N', 'E', 'T', 'B', 'I', 'N' };
+		static constexpr uint32_t Version = 3;
+
+		struct Header {
+			char magic[8];
+			uint32_t version;
+			uint32_t headerSize;
+			uint32_t kingBuckets;
+			uint32_t inputSize;
+			uint32_t halfInputSize;
+			uint32_t layer1;
+			uint32_t layer2;
+			uint32_t layer3;
+			uint64_t payloadSize;
+			uint64_t checksum;
+			uint64_t sourceSize;
+			uint64_t sourceChecksum;
+			uint8_t reserved[56];
+		};
+		static_assert(sizeof(Header) == 128, "payload has to stay 64 byte aligned behind the header");
+
+		//Tensors inside the payload start on cache lines as well
+		static constexpr size_t Aligned(size_t bytes) { return (bytes + 63) & ~size_t(63); }
+
+		enum class Error : uint8_t {
+			None, Open, Size, Magic, Version, Architecture, Checksum, Write, Overflow, Stale
+		};
+
+		static constexpr const char* ErrorStr(Error error) {
+			switch (error) {
+			case Error::None: return "ok";
+			case Error::Open: return "cannot open file";
+			case Error::Size: return "size does not match the network";
+			case Error::Magic: return "not a network file";
+			case Error::Version: return "unsupported file version";
+			case Error::Architecture: return "network architecture does not match";
+			case Error::Checksum: return "checksum mismatch";
+			case Error::Write: return "cannot write file";
+			case Error::Overflow: return "first layer could overflow the int16 accumulator";
+			case Error::Stale: return "converted from a different genome text, run NetConvert again";
+			}
+			return "unknown error";
+		}
+
+		//FNV-1a over 8 byte words - a few ms for the whole net, enough to catch truncated or corrupted files
+		static uint64_t Checksum(const uint8_t* data, size_t size)
+		{
+			uint64_t hash = 0xcbf29ce484222325ull;
+			size_t i = 0;
+			for (; i + 8 <= size; i += 8) {
+				uint64_t word;
+				std::memcpy(&word, data + i, 8);
+				hash = (hash ^ word) * 0x100000001b3ull;
+			}
+			for (; i < size; i++) hash = (hash ^ data[i]) * 0x100000001b3ull;
+			return hash;
+		}
+
+		//Unique per process so concurrent NetConvert runs do not clobber each other
+		static std::string TempPath(const char* path)
+		{
+#ifdef _WIN32
+			const unsigned long pid = GetCurrentProcessId();
+#else
+			const unsigned long pid = (unsigned long)getpid();
+#endif
+			return std::string(path) + "." + std::to_string(pid) + ".tmp";
+		}
+
+		//Puts temp in place of path in one step. std::rename does not replace an existing file on Windows
+		static bool Replace(const std::string& temp, const char* path)
+		{
+#ifdef _WIN32
+			return MoveFileExA(temp.c_str(), path, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+			return std::rename(temp.c_str(), path) == 0;
+#endif
+		}
+
+		//Checks a mapped file against the header the loader expects (checksum is ignored in expected)
+		static Error Validate(const uint8_t* data, size_t size, const Header& expected)
+		{
+			if (size < sizeof(Header)) return Error::Size;
+
+			Header header;
+			std::memcpy(&header, data, sizeof(Header));
+			if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0) return Error::Magic;
+			if (header.version != Version || header.headerSize != sizeof(Header)) return Error::Version;
+			if (header.kingBuckets != expected.kingBuckets || header.inputSize != expected.inputSize || header.halfInputSize != expected.halfInputSize
+				|| header.layer1 != expected.layer1 || header.layer2 != expected.layer2 || header.layer3 != expected.layer3
+				|| header.payloadSize != expected.payloadSize) return Error::Architecture;
+			if (size != sizeof(Header) + header.payloadSize) return Error::Size;
+			if (Checksum(data + sizeof(Header), size_t(header.payloadSize)) != header.checksum) return Error::Checksum;
+			return Error::None;
+		}
+	}
+
+	namespace NetFile {
+		//Genome text a net is converted from, as recorded in the header
+		struct Source {
+			uint64_t size = 0;
+			uint64_t checksum = 0;
+		};
+
+		//All zero when the file cannot be read
+		inline Source SourceOf(const char* path)
+		{
+			const Gigantua::MappedFile file(path);
+			if (!file.IsOpen()) return {};
+			return { file.Size(), Checksum(file.Data(), file.Size()) };
+		}
+
+		//One float per line. Empty when the file cannot be read
+		inline std::vector<float> ReadGenome(const char* path)
+		{
+			std::vector<float> genome;
+			std::ifstream file(path);
+			float value;
+			while (file >> value) genome.push_back(value);
+			return genome;
+		}
+	}
+}
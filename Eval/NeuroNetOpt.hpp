@@ -1,11 +1,21 @@
 ﻿#pragma once
 
 #include <../Gigantua/ChessBase.hpp>
+#include <../Gigantua/LargePages.hpp>
 #include <array>
 #include <vector>
-#include <immintrin.h>
+#include "NeuroNetSimd.hpp"
+#include "NeuroNetFile.hpp"
 #include <algorithm>
 #include <cstring>
+#include <memory>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <functional>
 
 namespace NN
 {
@@ -15,34 +25,170 @@ namespace NN
 		static constexpr std::array<uint32_t, 3> Architecture = { 512, 32, 32 };
 		static constexpr size_t ActiveIndexSize = 32;
 		static constexpr size_t HalfInputSize = Architecture[0] >> 1;
-		int16_t* mFirstWeights;
-		int32_t* mFirstBiases;
-		int8_t* mWeights1;
-		int32_t* mBiases1;
-		int8_t* mWeights2;
-		int32_t* mBiases2;
-		int8_t* mWeights3;
-		int32_t mBiases3;
+		//Floats in the genome text: first layer and biases for each of the 64 king squares, then the dense layers
+		static constexpr size_t GenomeSize = 64 * (InputSize + 1) * HalfInputSize
+			+ (Architecture[0] + 1) * Architecture[1] + (Architecture[1] + 1) * Architecture[2] + Architecture[2] + 1;
+
+		//Byte offsets of the tensors in one 64 byte aligned block. The block is also the payload of the binary net file.
+		//The first layer comes last, its size depends on the number of king buckets
+		static constexpr size_t Weights1Offset = 0;
+		static constexpr size_t Biases1Offset = Weights1Offset + NetFile::Aligned(Architecture[0] * Architecture[1] * sizeof(int8_t));
+		static constexpr size_t Weights2Offset = Biases1Offset + NetFile::Aligned(Architecture[1] * sizeof(int32_t));
+		static constexpr size_t Biases2Offset = Weights2Offset + NetFile::Aligned(Architecture[1] * Architecture[2] * sizeof(int8_t));
+		static constexpr size_t Weights3Offset = Biases2Offset + NetFile::Aligned(Architecture[2] * sizeof(int32_t));
+		static constexpr size_t Biases3Offset = Weights3Offset + NetFile::Aligned(Architecture[2] * sizeof(int8_t));
+		static constexpr size_t FirstBiasesOffset = Biases3Offset + NetFile::Aligned(sizeof(int32_t));
+		static constexpr size_t FirstWeightsOffset(uint32_t kingBuckets) { return FirstBiasesOffset + NetFile::Aligned(HalfInputSize * kingBuckets * sizeof(int16_t)); }
+		static constexpr size_t WeightsSize(uint32_t kingBuckets) { return FirstWeightsOffset(kingBuckets) + NetFile::Aligned(InputSize * HalfInputSize * kingBuckets * sizeof(int16_t)); }
+
+		//Const views into mOwned or, after Load, into the file mapping. A mapped net is shared by every process
+		//that loads the same file - the pages come from the page cache and are never copied
+		const int16_t* mFirstWeights;
+		const int16_t* mFirstBiases;
+		const int8_t* mWeights1;
+		const int32_t* mBiases1;
+		const int8_t* mWeights2;
+		const int32_t* mBiases2;
+		const int8_t* mWeights3;
+		const int32_t* mBiases3;
+		void* mOwned = nullptr; //LargePages block of WeightsSize(mKingBuckets)
+		std::unique_ptr<Gigantua::MappedFile> mMapped;
+		std::array<uint8_t, 64> mMirrorSq; //Square after Board::Mirror
+		uint32_t mKingBuckets = 64; //64: one first layer per king square. 32: the board is mirrored horizontally when the king is on the e-h files
+		bool mSparseInput = false; //First hidden layer only visits non zero 4 byte input chunks - pays off once most are zero
 
 		NeuroNetOpt() {
-			mFirstWeights = (int16_t*)std::malloc(InputSize * HalfInputSize * 64 * sizeof(int16_t));
-			mFirstBiases = (int32_t*)std::malloc(HalfInputSize * 64 * sizeof(int32_t));
-			mWeights1 = (int8_t*)std::malloc(Architecture[0] * Architecture[1] * sizeof(int8_t));
-			mBiases1 = (int32_t*)std::malloc(Architecture[1] * sizeof(int32_t));
-			mWeights2 = (int8_t*)std::malloc(Architecture[1] * Architecture[2] * sizeof(int8_t));
-			mBiases2 = (int32_t*)std::malloc(Architecture[2] * sizeof(int32_t));
-			mWeights3 = (int8_t*)std::malloc(Architecture[2] * sizeof(int8_t));
+			for (uint8_t sq = 0; sq < 64; sq++) mMirrorSq[sq] = SquareOf(ReverseBits(1ull << sq));
+			Own(64);
 		}
 
 		~NeuroNetOpt()
 		{
-			free(mFirstWeights);
-			free(mFirstBiases);
-			free(mWeights1);
-			free(mBiases1);
-			free(mWeights2);
-			free(mBiases2);
-			free(mWeights3);
+			LargePages::Free(mOwned, WeightsSize(mKingBuckets));
+		}
+
+		NeuroNetOpt(const NeuroNetOpt&) = delete;
+		NeuroNetOpt& operator=(const NeuroNetOpt&) = delete;
+
+		void Bind(const uint8_t* base)
+		{
+			mFirstWeights = (const int16_t*)(base + FirstWeightsOffset(mKingBuckets));
+			mFirstBiases = (const int16_t*)(base + FirstBiasesOffset);
+			mWeights1 = (const int8_t*)(base + Weights1Offset);
+			mBiases1 = (const int32_t*)(base + Biases1Offset);
+			mWeights2 = (const int8_t*)(base + Weights2Offset);
+			mBiases2 = (const int32_t*)(base + Biases2Offset);
+			mWeights3 = (const int8_t*)(base + Weights3Offset);
+			mBiases3 = (const int32_t*)(base + Biases3Offset);
+		}
+
+		//Switches to writable zeroed memory, padding included so saved files are reproducible. Returns the block
+		uint8_t* Own(uint32_t kingBuckets)
+		{
+			if (!mOwned || kingBuckets != mKingBuckets) {
+				LargePages::Free(mOwned, WeightsSize(mKingBuckets));
+				LargePages::Kind kind;
+				mOwned = LargePages::Alloc(WeightsSize(kingBuckets), kind);
+				if (!mOwned) throw std::bad_alloc();
+				mMapped.reset();
+			}
+			mKingBuckets = kingBuckets;
+			uint8_t* base = (uint8_t*)mOwned;
+			Bind(base);
+			return base;
+		}
+
+		const uint8_t* WeightsData() const { return (const uint8_t*)mWeights1; }
+
+		static NetFile::Header FileHeader(uint32_t kingBuckets)
+		{
+			NetFile::Header header{};
+			std::memcpy(header.magic, NetFile::Magic, sizeof(header.magic));
+			header.version = NetFile::Version;
+			header.headerSize = sizeof(NetFile::Header);
+			header.kingBuckets = kingBuckets;
+			header.inputSize = InputSize;
+			header.halfInputSize = HalfInputSize;
+			header.layer1 = Architecture[0];
+			header.layer2 = Architecture[1];
+			header.layer3 = Architecture[2];
+			header.payloadSize = WeightsSize(kingBuckets);
+			return header;
+		}
+
+		//Maps a file written by Save. The weights stay in the page cache and are not copied. On error nothing changes.
+		//With sourcePath the file is refused as Stale when that genome text exists and is not the one it was converted from
+		NetFile::Error Load(const char* path, const char* sourcePath = nullptr)
+		{
+			auto file = std::make_unique<Gigantua::MappedFile>(path);
+			if (!file->IsOpen()) return NetFile::Error::Open;
+
+			//Anything but 32 fails the architecture check against the 64 bucket header
+			uint32_t kingBuckets = 64;
+			if (file->Size() >= sizeof(NetFile::Header))
+				std::memcpy(&kingBuckets, file->Data() + offsetof(NetFile::Header, kingBuckets), sizeof(kingBuckets));
+			if (kingBuckets != 32) kingBuckets = 64;
+
+			const NetFile::Error error = NetFile::Validate(file->Data(), file->Size(), FileHeader(kingBuckets));
+			if (error != NetFile::Error::None) return error;
+
+			if (sourcePath) {
+				NetFile::Header header;
+				std::memcpy(&header, file->Data(), sizeof(header));
+				const Gigantua::MappedFile source(sourcePath, Gigantua::MappedFile::Access::Sequential);
+				if (source.IsOpen() && (source.Size() != header.sourceSize || NetFile::Checksum(source.Data(), source.Size()) != header.sourceChecksum))
+					return NetFile::Error::Stale;
+			}
+
+			const uint8_t* payload = file->Data() + sizeof(NetFile::Header);
+			if (!FitsAccumulator((const int16_t*)(payload + FirstWeightsOffset(kingBuckets)), (const int16_t*)(payload + FirstBiasesOffset), kingBuckets))
+				return NetFile::Error::Overflow;
+
+			LargePages::Free(mOwned, WeightsSize(mKingBuckets));
+			mOwned = nullptr;
+			mKingBuckets = kingBuckets;
+			mMapped = std::move(file);
+			Bind(mMapped->Data() + sizeof(NetFile::Header));
+			return NetFile::Error::None;
+		}
+
+		//Written under a temporary name and renamed into place: engines that still map the old file keep their copy
+		//instead of faulting on a truncated one, and none of them ever maps a half written file
+		NetFile::Error Save(const char* path, const NetFile::Source& source = {}) const
+		{
+			NetFile::Header header = FileHeader(mKingBuckets);
+			header.checksum = NetFile::Checksum(WeightsData(), WeightsSize(mKingBuckets));
+			header.sourceSize = source.size;
+			header.sourceChecksum = source.checksum;
+
+			const std::string temp = NetFile::TempPath(path);
+			bool written;
+			{
+				std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+				file.write((const char*)&header, sizeof(header));
+				file.write((const char*)WeightsData(), WeightsSize(mKingBuckets));
+				written = file.good();
+			}
+			if (!written || !NetFile::Replace(temp, path)) {
+				std::remove(temp.c_str());
+				return NetFile::Error::Write;
+			}
+			return NetFile::Error::None;
+		}
+
+		//What the engines run at startup. The binary from NetConvert is mapped in milliseconds, the genome text takes
+		//seconds to parse. All engines on a host map the same file, so the weights sit in memory once. Nothing here
+		//writes it: a binary converted from another text or with other king buckets is skipped until NetConvert is run
+		//again, and the text is read instead. Problems with the binary other than a missing file are reported to log
+		NetFile::Error LoadOrRead(const char* binPath, const char* textPath, uint32_t kingBuckets, std::ostream& log)
+		{
+			NetFile::Error error = Load(binPath, textPath);
+			if (error == NetFile::Error::None && mKingBuckets == kingBuckets) return error;
+			if (error != NetFile::Error::None && error != NetFile::Error::Open)
+				log << binPath << ": " << NetFile::ErrorStr(error) << ", reading " << textPath << std::endl;
+			error = SetGenome(NetFile::ReadGenome(textPath), kingBuckets);
+			if (error != NetFile::Error::None) log << textPath << ": " << NetFile::ErrorStr(error) << std::endl;
+			return error;
 		}
 
 		struct ActiveIndex {
@@ -65,6 +211,13 @@ namespace NN
 			return size;
 		}
 
+		//Dense weights are stored in groups of 4 inputs: [in / 4][out][in % 4]. One 32 bit broadcast of 4 inputs
+		//then meets 4 consecutive weight bytes per output, which is what maddubs and vpdpbusd multiply and sum - see Simd::Kernels
+		template <uint32_t outDims>
+		static constexpr size_t WeightIndex(uint32_t in, uint32_t out) {
+			return size_t(in / 4) * outDims * 4 + out * 4 + in % 4;
+		}
+
 		template <uint32_t inDims, uint32_t outDims>
 		inline void affine_txfm(const int8_t* input, int8_t* output, const int32_t* biases, const int8_t* weights)
 		{
@@ -74,10 +227,9 @@ namespace NN
 			for (uint32_t idx = 0; idx < inDims; idx++) {
 				const int8_t inp = input[idx];
 				if (inp == 0) continue;
-				const int8_t* w = weights + idx * outDims;
 
 				for (uint32_t i = 0; i < outDims; i++) {
-					tmp[i] += inp * w[i];
+					tmp[i] += inp * weights[WeightIndex<outDims>(idx, i)];
 				}
 			}
 
@@ -85,48 +237,9 @@ namespace NN
 				output[i] = std::clamp(tmp[i] >> 6, 0, 127);
 		}
 
-		template <uint32_t inDims>
-		inline void affine_txfm_32_avx2(
-			const int8_t* input,
-			int8_t* output,
-			const int32_t* biases,
-			const int8_t* weights)
-		{
-			// 32 outputs → 4 vectors of 8 int32 each
-			__m256i acc0 = _mm256_loadu_si256((__m256i*)(biases + 0));
-			__m256i acc1 = _mm256_loadu_si256((__m256i*)(biases + 8));
-			__m256i acc2 = _mm256_loadu_si256((__m256i*)(biases + 16));
-			__m256i acc3 = _mm256_loadu_si256((__m256i*)(biases + 24));
-
-			for (uint32_t idx = 0; idx < inDims; idx++) {
-				__m256i vinp = _mm256_set1_epi32(input[idx]);
-				const int8_t* w = weights + idx * 32;
-
-				__m256i w0 = _mm256_cvtepi8_epi32(_mm_loadl_epi64((__m128i*)(w + 0)));
-				__m256i w1 = _mm256_cvtepi8_epi32(_mm_loadl_epi64((__m128i*)(w + 8)));
-				__m256i w2 = _mm256_cvtepi8_epi32(_mm_loadl_epi64((__m128i*)(w + 16)));
-				__m256i w3 = _mm256_cvtepi8_epi32(_mm_loadl_epi64((__m128i*)(w + 24)));
-
-				acc0 = _mm256_add_epi32(acc0, _mm256_mullo_epi32(vinp, w0));
-				acc1 = _mm256_add_epi32(acc1, _mm256_mullo_epi32(vinp, w1));
-				acc2 = _mm256_add_epi32(acc2, _mm256_mullo_epi32(vinp, w2));
-				acc3 = _mm256_add_epi32(acc3, _mm256_mullo_epi32(vinp, w3));
-			}
-
-			// Store accumulators into a temporary array
-			alignas(32) int32_t tmp[32];
-			_mm256_storeu_si256((__m256i*)(tmp + 0), acc0);
-			_mm256_storeu_si256((__m256i*)(tmp + 8), acc1);
-			_mm256_storeu_si256((__m256i*)(tmp + 16), acc2);
-			_mm256_storeu_si256((__m256i*)(tmp + 24), acc3);
-
-			for (int i = 0; i < 32; i++) {
-				output[i] = (int8_t)std::clamp(tmp[i] >> 6, 0, 127);
-			}
-		}
-
+		//Original scalar transformer - int32 sums over a mirrored board copy. Kept as the reference for the eval benchmark
 		template <bool white>
-		inline void FillAcc(int32_t* acc, const Gigantua::Board& brd)
+		inline void FillAccReference(int32_t* acc, const Gigantua::Board& brd)
 		{
 			std::vector<uint64_t> bitBoards(10);
 			const auto mirr = brd.Mirror();
@@ -141,6 +254,9 @@ namespace NN
 			bitBoards[7] = brd.BRook;
 			bitBoards[8] = brd.WQueen;
 			bitBoards[9] = brd.BQueen;
+			if (Flipped<true>(brd)) {
+				for (uint64_t& bb : bitBoards) bb = FlipFiles(bb);
+			}
 
 			ActiveIndex mIndexW;
 
@@ -159,6 +275,9 @@ namespace NN
 			bitBoards[7] = mirr.BRook;
 			bitBoards[8] = mirr.WQueen;
 			bitBoards[9] = mirr.BQueen;
+			if (Flipped<false>(brd)) {
+				for (uint64_t& bb : bitBoards) bb = FlipFiles(bb);
+			}
 
 			ActiveIndex mIndexB;
 
@@ -167,11 +286,13 @@ namespace NN
 				mIndexB.size = GetInput(bitBoards, iPtr);
 			}
 
-			const uint8_t wKingIndex = SquareOf(brd.WKing);
-			const uint8_t bKingIndex = SquareOf(mirr.WKing);
+			const uint8_t wKingIndex = KingBucket<true>(brd);
+			const uint8_t bKingIndex = KingBucket<false>(brd);
 
-			std::memcpy(acc, mFirstBiases + wKingIndex * HalfInputSize, HalfInputSize * sizeof(int32_t));
-			std::memcpy(acc + HalfInputSize, mFirstBiases + bKingIndex * HalfInputSize, HalfInputSize * sizeof(int32_t));
+			for (uint32_t i = 0; i < HalfInputSize; i++) {
+				acc[i] = mFirstBiases[wKingIndex * HalfInputSize + i];
+				acc[HalfInputSize + i] = mFirstBiases[bKingIndex * HalfInputSize + i];
+			}
 
 			if constexpr (white) {
 				int32_t* accPtr = acc;
@@ -222,84 +343,414 @@ namespace NN
 
 		}
 
+		//First layer sums of both perspectives without biases. [0] sees the board as is, [1] sees Board::Mirror.
+		//Kept per search ply and updated from the previous ply
+		struct Accumulator {
+			alignas(32) std::array<std::array<int16_t, HalfInputSize>, 2> half;
+		};
+
+		//Last accumulator built for each king bucket (and side of the board with 32 buckets) and the pieces it was built from (Finny table). One per search thread.
+		//A king move into a bucket only applies the difference to that entry. Zeroed entries stand for the empty board
+		struct RefreshCache {
+			struct Entry {
+				alignas(32) std::array<int16_t, HalfInputSize> acc{};
+				std::array<uint64_t, 10> pieces{};
+			};
+			std::array<std::array<Entry, 64>, 2> entries;
+		};
+
+		//Swaps the a and h files, b and g and so on
+		static uint64_t FlipFiles(uint64_t bb) {
+			bb = ((bb >> 1) & 0x5555555555555555ull) | ((bb & 0x5555555555555555ull) << 1);
+			bb = ((bb >> 2) & 0x3333333333333333ull) | ((bb & 0x3333333333333333ull) << 2);
+			return ((bb >> 4) & 0x0F0F0F0F0F0F0F0Full) | ((bb & 0x0F0F0F0F0F0F0F0Full) << 4);
+		}
+
+		//King square as seen by one side
+		template<bool white>
+		uint8_t KingSq(const Gigantua::Board& brd) const {
+			if constexpr (white) return SquareOf(brd.WKing);
+			else return mMirrorSq[SquareOf(brd.BKing)];
+		}
+
+		//32 buckets only: this side sees the board mirrored horizontally, its king is on the e-h files (sq % 8 < 4 with bit 0 = h1).
+		//The flip commutes with Board::Mirror, so it is applied to the board squares before FeatureSq
+		template<bool white>
+		bool Flipped(const Gigantua::Board& brd) const {
+			return mKingBuckets == 32 && (KingSq<white>(brd) & 7) < 4;
+		}
+
+		template<bool white>
+		uint8_t KingBucket(const Gigantua::Board& brd) const {
+			const uint8_t sq = KingSq<white>(brd);
+			if (mKingBuckets == 64) return sq;
+			const uint8_t flipped = (sq & 7) < 4 ? sq ^ 7 : sq;
+			return (flipped >> 3) * 4 + (flipped & 7) - 4;
+		}
+
+		//Refresh cache entry. Both sides of the board share a bucket with 32 buckets but not their piece orientation
+		template<bool white>
+		uint8_t CacheSlot(const Gigantua::Board& brd) const {
+			return KingBucket<white>(brd) + (Flipped<white>(brd) ? 32 : 0);
+		}
+
+		//Piece bitboards in feature order as seen by one side, flipped horizontally if needed. Squares are not mirrored yet
+		template<bool white>
+		std::array<uint64_t, 10> Features(const Gigantua::Board& brd) const {
+			std::array<uint64_t, 10> features;
+			if constexpr (white) features = { brd.WPawn, brd.BPawn, brd.WKnight, brd.BKnight, brd.WBishop, brd.BBishop, brd.WRook, brd.BRook, brd.WQueen, brd.BQueen };
+			else features = { brd.BPawn, brd.WPawn, brd.BKnight, brd.WKnight, brd.BBishop, brd.WBishop, brd.BRook, brd.WRook, brd.BQueen, brd.WQueen };
+			if (Flipped<white>(brd)) {
+				for (uint64_t& bb : features) bb = FlipFiles(bb);
+			}
+			return features;
+		}
+
+		template<bool white>
+		uint16_t FeatureSq(uint8_t sq) const {
+			if constexpr (white) return sq;
+			else return mMirrorSq[sq];
+		}
+
+		//dst = src + added rows - removed rows. src may be null for zero or equal to dst
+		static void AddSub(const int16_t* src, int16_t* dst, const int16_t* const* added, uint8_t addedNum, const int16_t* const* removed, uint8_t removedNum)
+		{
+			switch (Simd::Active()) {
+			case Simd::Level::AVX512VNNI: return Simd::Kernels<Simd::Level::AVX512VNNI>::AddSub<HalfInputSize>(src, dst, added, addedNum, removed, removedNum);
+			case Simd::Level::AVX2: return Simd::Kernels<Simd::Level::AVX2>::AddSub<HalfInputSize>(src, dst, added, addedNum, removed, removedNum);
+			default: return Simd::Kernels<Simd::Level::SSE41>::AddSub<HalfInputSize>(src, dst, added, addedNum, removed, removedNum);
+			}
+		}
+
+		//Weight rows of the pieces that left (from & ~to) and entered (to & ~from) a square
+		template<bool white>
+		void DiffRows(uint8_t bucket, const std::array<uint64_t, 10>& from, const std::array<uint64_t, 10>& to,
+			const int16_t** added, uint8_t& addedNum, const int16_t** removed, uint8_t& removedNum) const
+		{
+			const int16_t* weights = mFirstWeights + bucket * InputSize * HalfInputSize;
+			addedNum = removedNum = 0;
+			for (uint16_t f = 0; f < from.size(); f++) {
+				uint64_t gone = from[f] & ~to[f];
+				uint64_t came = to[f] & ~from[f];
+				Bitloop(gone) removed[removedNum++] = weights + HalfInputSize * (f * 64 + FeatureSq<white>(SquareOf(gone)));
+				Bitloop(came) added[addedNum++] = weights + HalfInputSize * (f * 64 + FeatureSq<white>(SquareOf(came)));
+			}
+		}
+
+		template<bool white>
+		void RefreshHalf(int16_t* acc, const Gigantua::Board& brd)
+		{
+			//Nothing is removed from an empty board, zeroed so the unrolled kernels never see uninitialized rows
+			const int16_t* added[32] = {};
+			const int16_t* removed[32] = {};
+			uint8_t addedNum, removedNum;
+			DiffRows<white>(KingBucket<white>(brd), {}, Features<white>(brd), added, addedNum, removed, removedNum);
+			AddSub(nullptr, acc, added, addedNum, removed, removedNum);
+		}
+
+		void Refresh(Accumulator& acc, const Gigantua::Board& brd)
+		{
+			RefreshHalf<true>(acc.half[0].data(), brd);
+			RefreshHalf<false>(acc.half[1].data(), brd);
+		}
+
+		template<bool white>
+		void RefreshHalf(int16_t* acc, const Gigantua::Board& brd, RefreshCache& cache)
+		{
+			const uint8_t bucket = KingBucket<white>(brd);
+			auto& entry = cache.entries[white ? 0 : 1][CacheSlot<white>(brd)];
+			const auto pieces = Features<white>(brd);
+
+			ApplyDiff<white>(entry.acc.data(), entry.acc.data(), bucket, entry.pieces, pieces);
+			entry.pieces = pieces;
+			std::memcpy(acc, entry.acc.data(), HalfInputSize * sizeof(int16_t));
+		}
+
+		void Refresh(Accumulator& acc, const Gigantua::Board& brd, RefreshCache& cache)
+		{
+			RefreshHalf<true>(acc.half[0].data(), brd, cache);
+			RefreshHalf<false>(acc.half[1].data(), brd, cache);
+		}
+
+		//Adds the pieces that entered a square and subtracts the ones that left - from, to, captured, castling rook, promotion
+		template<bool white>
+		void ApplyDiff(const int16_t* prev, int16_t* next, uint8_t bucket, const std::array<uint64_t, 10>& from, const std::array<uint64_t, 10>& to)
+		{
+			const int16_t* added[32];
+			const int16_t* removed[32];
+			uint8_t addedNum, removedNum;
+			DiffRows<white>(bucket, from, to, added, addedNum, removed, removedNum);
+			AddSub(prev, next, added, addedNum, removed, removedNum);
+		}
+
+		//A king move into a new bucket or across the board middle changes every weight of that side - it goes through the refresh cache
+		template<bool white>
+		void UpdateHalf(const int16_t* prev, int16_t* next, const Gigantua::Board& before, const Gigantua::Board& after, RefreshCache& cache)
+		{
+			if (CacheSlot<white>(before) != CacheSlot<white>(after)) {
+				RefreshHalf<white>(next, after, cache);
+				return;
+			}
+
+			ApplyDiff<white>(prev, next, KingBucket<white>(after), Features<white>(before), Features<white>(after));
+		}
+
+		void Update(const Accumulator& prev, Accumulator& next, const Gigantua::Board& before, const Gigantua::Board& after, RefreshCache& cache)
+		{
+			UpdateHalf<true>(prev.half[0].data(), next.half[0].data(), before, after, cache);
+			UpdateHalf<false>(prev.half[1].data(), next.half[1].data(), before, after, cache);
+		}
+
+		//Adds the king bucket biases and packs to the int8 layer input with saturation, clamped at 0.
+		//The side to move comes first. Biases keep the FillAccReference pairing: white king bucket first, black second
+		void Transform(const Gigantua::Board& brd, const Accumulator& acc, int8_t* input) const
+		{
+			const bool white = brd.status.WhiteMove();
+			const int16_t* halves[2] = { acc.half[white ? 0 : 1].data(), acc.half[white ? 1 : 0].data() };
+			const int16_t* biases[2] = { mFirstBiases + KingBucket<true>(brd) * HalfInputSize, mFirstBiases + KingBucket<false>(brd) * HalfInputSize };
+
+			for (uint32_t h = 0; h < 2; h++) {
+				switch (Simd::Active()) {
+				case Simd::Level::AVX512VNNI: Simd::Kernels<Simd::Level::AVX512VNNI>::Transform<HalfInputSize>(halves[h], biases[h], input + h * HalfInputSize); break;
+				case Simd::Level::AVX2: Simd::Kernels<Simd::Level::AVX2>::Transform<HalfInputSize>(halves[h], biases[h], input + h * HalfInputSize); break;
+				default: Simd::Kernels<Simd::Level::SSE41>::Transform<HalfInputSize>(halves[h], biases[h], input + h * HalfInputSize); break;
+				}
+			}
+		}
+
+		//Allocation free first layer straight from the bitboards
+		void FillAcc(int8_t* input, const Gigantua::Board& brd)
+		{
+			Accumulator acc;
+			Refresh(acc, brd);
+			Transform(brd, acc, input);
+		}
+
+		//Same result as Evaluate(brd) from an accumulator that matches brd
+		int32_t Evaluate(const Gigantua::Board& brd, const Accumulator& acc)
+		{
+			alignas(32) int8_t input[Architecture[0]];
+			Transform(brd, acc, input);
+			return Propagate(input);
+		}
+
 		int32_t Evaluate(const Gigantua::Board& brd)
+		{
+			alignas(32) int8_t input[Architecture[0]];
+			FillAcc(input, brd);
+			return Propagate(input);
+		}
+
+		int32_t EvaluateReference(const Gigantua::Board& brd)
 		{
 			int8_t input[Architecture[0]];
 
 			{//NNUE first layer evaluation
 				int32_t acc[Architecture[0]];
 				if (brd.status.WhiteMove())
-					FillAcc<true>(acc, brd);
+					FillAccReference<true>(acc, brd);
 				else
-					FillAcc<false>(acc, brd);
+					FillAccReference<false>(acc, brd);
 
 				for (uint32_t i = 0; i < Architecture[0]; i++) {
 					input[i] = int8_t(std::clamp(acc[i], 0, 127));
 				}
 			}
 
+			return PropagateReference(input);
+		}
+
+		template<Simd::Level L>
+		int32_t PropagateWith(const int8_t* input)
+		{
+			alignas(32) int8_t output[Architecture[1]];
+			if (mSparseInput)
+				Simd::Kernels<L>::template AffineSparse<Architecture[0]>(input, output, mBiases1, mWeights1);
+			else
+				Simd::Kernels<L>::template Affine<Architecture[0]>(input, output, mBiases1, mWeights1);
+			Simd::Kernels<L>::template Affine<Architecture[1]>(output, output, mBiases2, mWeights2);
+
+			return Output(output);
+		}
+
+		//Dense layers behind the first layer
+		int32_t Propagate(const int8_t* input)
+		{
+			switch (Simd::Active()) {
+			case Simd::Level::AVX512VNNI: return PropagateWith<Simd::Level::AVX512VNNI>(input);
+			case Simd::Level::AVX2: return PropagateWith<Simd::Level::AVX2>(input);
+			default: return PropagateWith<Simd::Level::SSE41>(input);
+			}
+		}
+
+		int32_t PropagateReference(const int8_t* input)
+		{
 			int8_t output[Architecture[1]];
-			//affine_txfm<Architecture[0], Architecture[1]>(input, output, mBiases1, mWeights1);
-			//affine_txfm<Architecture[1], Architecture[2]>(output, output, mBiases2, mWeights2);
+			affine_txfm<Architecture[0], Architecture[1]>(input, output, mBiases1, mWeights1);
+			affine_txfm<Architecture[1], Architecture[2]>(output, output, mBiases2, mWeights2);
 
-			affine_txfm_32_avx2<512>(input, output, mBiases1, mWeights1);
-			affine_txfm_32_avx2<32>(output, output, mBiases2, mWeights2);
+			return Output(output);
+		}
 
-			int32_t result = mBiases3;
+		int32_t Output(const int8_t* input) const
+		{
+			int32_t result = *mBiases3;
 			for (uint32_t i = 0; i < Architecture[2]; i++) {
-				result += output[i] * mWeights3[i];
+				result += input[i] * mWeights3[i];
 			}
 
 			return result / 16;
 		}
 
-		void SetGenome(const std::vector<float>& genome)
+		//The genome always holds 64 king buckets. 32 buckets fold each king square and its horizontal mirror into one
+		//bucket by averaging, the mirrored square with its feature squares flipped as well
+		//The accumulator adds feature rows in int16 without saturation. Kings are not features, so at most 30 rows are
+		//active: a net is only accepted when for every neuron the largest bias plus the 30 largest weight magnitudes of
+		//any bucket fits int16. Transform pairs a half with either king's bias, hence the maximum over all buckets
+		static constexpr size_t MaxActiveFeatures = 30;
+
+		static bool FitsAccumulator(const int16_t* firstWeights, const int16_t* firstBiases, uint32_t kingBuckets)
 		{
+			std::array<int32_t, HalfInputSize> maxBias{};
+			std::array<int32_t, HalfInputSize> maxSum{};
+			std::array<int32_t, HalfInputSize> maxWeight;
+			std::vector<int32_t> magnitudes;
+
+			for (size_t b = 0; b < kingBuckets; b++) {
+				for (size_t j = 0; j < HalfInputSize; j++) maxBias[j] = std::max(maxBias[j], std::abs(int32_t(firstBiases[b * HalfInputSize + j])));
+			}
+
+			for (size_t b = 0; b < kingBuckets; b++) {
+				const int16_t* weights = firstWeights + b * InputSize * HalfInputSize;
+
+				//30 times the largest magnitude settles it for most nets in one sequential pass
+				maxWeight.fill(0);
+				for (size_t i = 0; i < InputSize; i++) {
+					for (size_t j = 0; j < HalfInputSize; j++) maxWeight[j] = std::max(maxWeight[j], std::abs(int32_t(weights[i * HalfInputSize + j])));
+				}
+
+				for (size_t j = 0; j < HalfInputSize; j++) {
+					int32_t sum = int32_t(MaxActiveFeatures) * maxWeight[j];
+					if (maxBias[j] + sum > std::numeric_limits<int16_t>::max()) {
+						magnitudes.resize(InputSize);
+						for (size_t i = 0; i < InputSize; i++) magnitudes[i] = std::abs(int32_t(weights[i * HalfInputSize + j]));
+						std::nth_element(magnitudes.begin(), magnitudes.begin() + MaxActiveFeatures, magnitudes.end(), std::greater<int32_t>());
+						sum = 0;
+						for (size_t i = 0; i < MaxActiveFeatures; i++) sum += magnitudes[i];
+					}
+					maxSum[j] = std::max(maxSum[j], sum);
+				}
+			}
+
+			for (size_t j = 0; j < HalfInputSize; j++) {
+				if (maxBias[j] + maxSum[j] > std::numeric_limits<int16_t>::max()) return false;
+			}
+			return true;
+		}
+
+		//Truncates like the int16_t cast, false outside the int16 range
+		static bool Quantize16(float value, int16_t& result)
+		{
+			if (!(value > -32769.0f && value < 32768.0f)) return false;
+			result = int16_t(value);
+			return true;
+		}
+
+		//Refuses a genome of the wrong length (Error::Size) and a first layer the int16 accumulator could wrap on
+		//(Error::Overflow). The current net stays then
+		NetFile::Error SetGenome(const std::vector<float>& genome, uint32_t kingBuckets = 64)
+		{
+			if (genome.size() != GenomeSize) return NetFile::Error::Size;
+			std::vector<int16_t> first(size_t(kingBuckets) * InputSize * HalfInputSize);
+			std::vector<int16_t> firstBias(size_t(kingBuckets) * HalfInputSize);
+			bool inRange = true;
+
 			size_t k = 0;
-			for(size_t b = 0; b < 64; b++)
-			{// first layer
-				for (size_t i = 0; i < InputSize; ++i) {
+			if (kingBuckets == 64) {
+				for (size_t b = 0; b < 64; b++)
+				{// first layer
+					for (size_t i = 0; i < InputSize; ++i) {
+						for (size_t j = 0; j < HalfInputSize; ++j) {
+							inRange &= Quantize16(genome[k++], first[b * InputSize * HalfInputSize + i * HalfInputSize + j]);
+						}
+					}
+
 					for (size_t j = 0; j < HalfInputSize; ++j) {
-						mFirstWeights[b * InputSize * HalfInputSize + i * HalfInputSize + j] = int16_t(genome[k++]);
+						inRange &= Quantize16(genome[k++], firstBias[b * HalfInputSize + j]);
 					}
 				}
+			}
+			else {
+				std::vector<float> weights(size_t(32) * InputSize * HalfInputSize);
+				std::vector<float> biases(size_t(32) * HalfInputSize);
+				for (size_t b = 0; b < 64; b++)
+				{// first layer, king square b and features as seen by the side
+					const bool flip = (b & 7) < 4;
+					const size_t sq = flip ? b ^ 7 : b;
+					const size_t bucket = (sq >> 3) * 4 + (sq & 7) - 4;
+					for (size_t i = 0; i < InputSize; ++i) {
+						const size_t feature = flip ? i ^ 7 : i;
+						for (size_t j = 0; j < HalfInputSize; ++j) {
+							weights[bucket * InputSize * HalfInputSize + feature * HalfInputSize + j] += genome[k++];
+						}
+					}
 
-				for (size_t j = 0; j < HalfInputSize; ++j) {
-					mFirstBiases[b * HalfInputSize + j] = int16_t(genome[k++]);
+					for (size_t j = 0; j < HalfInputSize; ++j) {
+						biases[bucket * HalfInputSize + j] += genome[k++];
+					}
 				}
+
+				for (size_t i = 0; i < weights.size(); i++) inRange &= Quantize16(weights[i] * 0.5f, first[i]);
+				for (size_t i = 0; i < biases.size(); i++) inRange &= Quantize16(biases[i] * 0.5f, firstBias[i]);
 			}
 
+			if (!inRange || !FitsAccumulator(first.data(), firstBias.data(), kingBuckets)) return NetFile::Error::Overflow;
+
+			uint8_t* base = Own(kingBuckets);
+			int16_t* firstWeights = (int16_t*)(base + FirstWeightsOffset(kingBuckets));
+			int16_t* firstBiases = (int16_t*)(base + FirstBiasesOffset);
+			int8_t* weights1 = (int8_t*)(base + Weights1Offset);
+			int32_t* biases1 = (int32_t*)(base + Biases1Offset);
+			int8_t* weights2 = (int8_t*)(base + Weights2Offset);
+			int32_t* biases2 = (int32_t*)(base + Biases2Offset);
+			int8_t* weights3 = (int8_t*)(base + Weights3Offset);
+			int32_t* biases3 = (int32_t*)(base + Biases3Offset);
+
+			std::memcpy(firstWeights, first.data(), first.size() * sizeof(int16_t));
+			std::memcpy(firstBiases, firstBias.data(), firstBias.size() * sizeof(int16_t));
+
 			{
 				for (size_t i = 0; i < Architecture[0]; ++i) {
 					for (size_t j = 0; j < Architecture[1]; ++j) {
-						mWeights1[i* Architecture[1]  + j] = int8_t(genome[k++] * 64.0f);
+						weights1[WeightIndex<Architecture[1]>(uint32_t(i), uint32_t(j))] = int8_t(genome[k++] * 64.0f);
 					}
 				}
 
 				for (size_t j = 0; j < Architecture[1]; ++j) {
-					mBiases1[j] = int32_t(genome[k++] * 64.0f);
+					biases1[j] = int32_t(genome[k++] * 64.0f);
 				}
 			}
 
 			{
 				for (size_t i = 0; i < Architecture[1]; ++i) {
 					for (size_t j = 0; j < Architecture[2]; ++j) {
-						mWeights2[i * Architecture[2] + j] = int8_t(genome[k++] * 64.0f);
+						weights2[WeightIndex<Architecture[2]>(uint32_t(i), uint32_t(j))] = int8_t(genome[k++] * 64.0f);
 					}
 				}
 
 				for (size_t j = 0; j < Architecture[2]; ++j) {
-					mBiases2[j] = int32_t(genome[k++] * 64.0f);
+					biases2[j] = int32_t(genome[k++] * 64.0f);
 				}
 			}
 
 			{
 				for (size_t i = 0; i < Architecture[2]; ++i) {
-					mWeights3[i] = int16_t(genome[k++] * 16.0f);
+					weights3[i] = int16_t(genome[k++] * 16.0f);
 				}
 
-				mBiases3 = int32_t(genome[k++] * 16.0f);
+				*biases3 = int32_t(genome[k++] * 16.0f);
 			}
+			return NetFile::Error::None;
 		}
 	};
 }
\ No newline at end of file
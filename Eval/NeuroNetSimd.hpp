@@ -0,0 +1,449 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+//Kernels are compiled for every level in the same binary - the translation unit itself needs no -mavx2.
+//MSVC accepts any intrinsic without a target attribute
+#if defined(__GNUC__) || defined(__clang__)
+#define _TargetSSE41 __attribute__((target("sse4.1,ssse3,popcnt")))
+#define _TargetAVX2 __attribute__((target("avx2,fma,popcnt")))
+#define _TargetAVX512VNNI __attribute__((target("avx512f,avx512bw,avx512vl,avx512vnni,avx2,fma,popcnt")))
+#else
+#define _TargetSSE41
+#define _TargetAVX2
+#define _TargetAVX512VNNI
+#endif
+
+namespace NN {
+namespace Simd {
+
+	enum class Level : uint8_t { SSE41, AVX2, AVX512VNNI };
+
+	static constexpr std::array<std::string_view, 3> LevelNames = { "sse4.1", "avx2", "avx512vnni" };
+
+	static constexpr std::string_view LevelStr(Level level) {
+		return LevelNames[size_t(level)];
+	}
+
+	//Best level the cpu and the os (saved register state) support
+	inline Level Detect()
+	{
+#if defined(__GNUC__) || defined(__clang__)
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vl") && __builtin_cpu_supports("avx512vnni"))
+			return Level::AVX512VNNI;
+		if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+			return Level::AVX2;
+		return Level::SSE41;
+#else
+		int info[4];
+		__cpuid(info, 0);
+		const int maxLeaf = info[0];
+
+		__cpuid(info, 1);
+		const bool osxsave = info[2] & (1 << 27);
+		const bool fma = info[2] & (1 << 12);
+		const uint64_t xcr0 = osxsave ? _xgetbv(0) : 0;
+		const bool ymmState = (xcr0 & 0x06) == 0x06;
+		const bool zmmState = (xcr0 & 0xe6) == 0xe6;
+		if (maxLeaf < 7 || !ymmState) return Level::SSE41;
+
+		__cpuidex(info, 7, 0);
+		const bool avx2 = info[1] & (1 << 5);
+		const bool avx512 = (info[1] & (1 << 16)) && (info[1] & (1 << 30)) && (info[1] & (1 << 31)); //f, bw, vl
+		const bool vnni = info[2] & (1 << 11);
+		if (avx512 && vnni && zmmState) return Level::AVX512VNNI;
+		if (avx2 && fma) return Level::AVX2;
+		return Level::SSE41;
+#endif
+	}
+
+	namespace detail {
+		inline const Level Detected = Detect();
+		inline Level Active = Detected;
+	}
+
+	//Level the network kernels run with
+	inline Level Active() { return detail::Active; }
+	inline Level Detected() { return detail::Detected; }
+
+	//Forces a level for benchmarking. Levels above the detected one are refused - they would fault
+	inline bool Force(Level level)
+	{
+		if (level > detail::Detected) return false;
+		detail::Active = level;
+		return true;
+	}
+
+	//"sse4.1", "avx2", "avx512vnni" or "auto"
+	inline bool Force(std::string_view name)
+	{
+		if (name == "auto") return Force(detail::Detected);
+		for (size_t i = 0; i < LevelNames.size(); i++)
+			if (name == LevelNames[i]) return Force(Level(i));
+		return false;
+	}
+
+	//Offsets of the set bits of every byte value, used to turn a movemask into chunk indices
+	inline constexpr std::array<std::array<uint16_t, 8>, 256> NonZeroLut = []() {
+		std::array<std::array<uint16_t, 8>, 256> lut{};
+		for (uint32_t mask = 0; mask < 256; mask++) {
+			uint32_t k = 0;
+			for (uint16_t bit = 0; bit < 8; bit++)
+				if (mask & (1u << bit)) lut[mask][k++] = bit;
+		}
+		return lut;
+	}();
+
+	//Network kernels per level. All of them give the same results:
+	//AddSub         dst = src + added rows - removed rows on int16 accumulators. src may be null for zero
+	//Transform      int16 accumulator + biases, saturated and clamped to the 0..127 int8 layer input
+	//FindNonZero    indices of the 4 byte input chunks that are not all zero, 8 more may be written past the count
+	//Affine         32 outputs, weights in [in / 4][out][in % 4] order, >> 6 and clamped to 0..127.
+	//               Inputs are 0..127 so a maddubs pair is at most 2 * 127 * 128 and never saturates
+	template<Level L>
+	struct Kernels;
+
+	template<>
+	struct Kernels<Level::SSE41>
+	{
+		template<uint32_t size>
+		_TargetSSE41 static void AddSub(const int16_t* src, int16_t* dst, const int16_t* const* added, uint8_t addedNum, const int16_t* const* removed, uint8_t removedNum)
+		{
+			constexpr uint32_t Regs = 8;
+			constexpr uint32_t Block = Regs * 8;
+			static_assert(size % Block == 0);
+			for (uint32_t b = 0; b < size; b += Block) {
+				__m128i acc[Regs];
+				for (uint32_t r = 0; r < Regs; r++)
+					acc[r] = src ? _mm_load_si128((const __m128i*)(src + b + r * 8)) : _mm_setzero_si128();
+
+				for (uint8_t j = 0; j < addedNum; j++) {
+					const int16_t* w = added[j] + b;
+					for (uint32_t r = 0; r < Regs; r++) acc[r] = _mm_add_epi16(acc[r], _mm_loadu_si128((const __m128i*)(w + r * 8)));
+				}
+				for (uint8_t j = 0; j < removedNum; j++) {
+					const int16_t* w = removed[j] + b;
+					for (uint32_t r = 0; r < Regs; r++) acc[r] = _mm_sub_epi16(acc[r], _mm_loadu_si128((const __m128i*)(w + r * 8)));
+				}
+
+				for (uint32_t r = 0; r < Regs; r++)
+					_mm_store_si128((__m128i*)(dst + b + r * 8), acc[r]);
+			}
+		}
+
+		template<uint32_t size>
+		_TargetSSE41 static void Transform(const int16_t* acc, const int16_t* biases, int8_t* output)
+		{
+			const __m128i zero = _mm_setzero_si128();
+			for (uint32_t i = 0; i < size; i += 16) {
+				const __m128i a = _mm_adds_epi16(_mm_load_si128((const __m128i*)(acc + i)), _mm_loadu_si128((const __m128i*)(biases + i)));
+				const __m128i b = _mm_adds_epi16(_mm_load_si128((const __m128i*)(acc + i + 8)), _mm_loadu_si128((const __m128i*)(biases + i + 8)));
+				_mm_storeu_si128((__m128i*)(output + i), _mm_max_epi8(_mm_packs_epi16(a, b), zero));
+			}
+		}
+
+		template<uint32_t inDims>
+		_TargetSSE41 static uint32_t FindNonZero(const int8_t* input, uint16_t* indices)
+		{
+			static_assert(inDims % 16 == 0);
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i step = _mm_set1_epi16(4);
+			__m128i base = _mm_setzero_si128();
+			uint32_t count = 0;
+
+			for (uint32_t i = 0; i < inDims; i += 16) {
+				const __m128i chunk = _mm_loadu_si128((const __m128i*)(input + i));
+				const uint32_t mask = ~uint32_t(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(chunk, zero)))) & 0xf;
+				const __m128i offsets = _mm_loadu_si128((const __m128i*)NonZeroLut[mask].data());
+				_mm_storeu_si128((__m128i*)(indices + count), _mm_add_epi16(base, offsets));
+				count += _mm_popcnt_u32(mask);
+				base = _mm_add_epi16(base, step);
+			}
+			return count;
+		}
+
+		_TargetSSE41 static void StoreClamped(const __m128i* acc, int8_t* output)
+		{
+			const __m128i zero = _mm_setzero_si128();
+			for (uint32_t h = 0; h < 2; h++) {
+				const __m128i* a = acc + h * 4;
+				const __m128i lo = _mm_packs_epi32(_mm_srai_epi32(a[0], 6), _mm_srai_epi32(a[1], 6));
+				const __m128i hi = _mm_packs_epi32(_mm_srai_epi32(a[2], 6), _mm_srai_epi32(a[3], 6));
+				_mm_storeu_si128((__m128i*)(output + h * 16), _mm_max_epi8(_mm_packs_epi16(lo, hi), zero));
+			}
+		}
+
+		_TargetSSE41 static void AddGroup(__m128i* acc, const int8_t* input, const int8_t* weights, uint32_t idx)
+		{
+			const __m128i ones = _mm_set1_epi16(1);
+			int32_t group;
+			std::memcpy(&group, input + idx, sizeof(group));
+			const __m128i vinp = _mm_set1_epi32(group);
+			const int8_t* w = weights + idx * 32;
+			for (uint32_t r = 0; r < 8; r++)
+				acc[r] = _mm_add_epi32(acc[r], _mm_madd_epi16(_mm_maddubs_epi16(vinp, _mm_loadu_si128((const __m128i*)(w + r * 16))), ones));
+		}
+
+		template<uint32_t inDims>
+		_TargetSSE41 static void Affine(const int8_t* input, int8_t* output, const int32_t* biases, const int8_t* weights)
+		{
+			__m128i acc[8];
+			for (uint32_t r = 0; r < 8; r++) acc[r] = _mm_loadu_si128((const __m128i*)(biases + r * 4));
+
+			for (uint32_t idx = 0; idx < inDims; idx += 4)
+				AddGroup(acc, input, weights, idx);
+
+			StoreClamped(acc, output);
+		}
+
+		template<uint32_t inDims>
+		_TargetSSE41 static void AffineSparse(const int8_t* input, int8_t* output, const int32_t* biases, const int8_t* weights)
+		{
+			uint16_t nonZero[inDims / 4 + 8];
+			const uint32_t count = FindNonZero<inDims>(input, nonZero);
+
+			__m128i acc[8];
+			for (uint32_t r = 0; r < 8; r++) acc[r] = _mm_loadu_si128((const __m128i*)(biases + r * 4));
+
+			for (uint32_t k = 0; k < count; k++)
+				AddGroup(acc, input, weights, nonZero[k] * 4u);
+
+			StoreClamped(acc, output);
+		}
+	};
+
+	template<>
+	struct Kernels<Level::AVX2>
+	{
+		//Runs over the lanes in blocks of 8 registers so every row is read once per block
+		template<uint32_t size>
+		_TargetAVX2 static void AddSub(const int16_t* src, int16_t* dst, const int16_t* const* added, uint8_t addedNum, const int16_t* const* removed, uint8_t removedNum)
+		{
+			constexpr uint32_t Regs = 8;
+			constexpr uint32_t Block = Regs * 16;
+			static_assert(size % Block == 0);
+			for (uint32_t b = 0; b < size; b += Block) {
+				__m256i acc[Regs];
+				for (uint32_t r = 0; r < Regs; r++)
+					acc[r] = src ? _mm256_load_si256((const __m256i*)(src + b + r * 16)) : _mm256_setzero_si256();
+
+				for (uint8_t j = 0; j < addedNum; j++) {
+					const int16_t* w = added[j] + b;
+					for (uint32_t r = 0; r < Regs; r++) acc[r] = _mm256_add_epi16(acc[r], _mm256_loadu_si256((const __m256i*)(w + r * 16)));
+				}
+				for (uint8_t j = 0; j < removedNum; j++) {
+					const int16_t* w = removed[j] + b;
+					for (uint32_t r = 0; r < Regs; r++) acc[r] = _mm256_sub_epi16(acc[r], _mm256_loadu_si256((const __m256i*)(w + r * 16)));
+				}
+
+				for (uint32_t r = 0; r < Regs; r++)
+					_mm256_store_si256((__m256i*)(dst + b + r * 16), acc[r]);
+			}
+		}
+
+		template<uint32_t size>
+		_TargetAVX2 static void Transform(const int16_t* acc, const int16_t* biases, int8_t* output)
+		{
+			const __m256i zero = _mm256_setzero_si256();
+			for (uint32_t i = 0; i < size; i += 32) {
+				const __m256i a = _mm256_adds_epi16(_mm256_load_si256((const __m256i*)(acc + i)), _mm256_loadu_si256((const __m256i*)(biases + i)));
+				const __m256i b = _mm256_adds_epi16(_mm256_load_si256((const __m256i*)(acc + i + 16)), _mm256_loadu_si256((const __m256i*)(biases + i + 16)));
+				//packs works per 128 bit lane - the permute restores the order
+				const __m256i packed = _mm256_permute4x64_epi64(_mm256_max_epi8(_mm256_packs_epi16(a, b), zero), 0b11011000);
+				_mm256_storeu_si256((__m256i*)(output + i), packed);
+			}
+		}
+
+		template<uint32_t inDims>
+		_TargetAVX2 static uint32_t FindNonZero(const int8_t* input, uint16_t* indices)
+		{
+			static_assert(inDims % 32 == 0);
+			const __m256i zero = _mm256_setzero_si256();
+			const __m128i step = _mm_set1_epi16(8);
+			__m128i base = _mm_setzero_si128();
+			uint32_t count = 0;
+
+			for (uint32_t i = 0; i < inDims; i += 32) {
+				const __m256i chunk = _mm256_loadu_si256((const __m256i*)(input + i));
+				const uint32_t mask = ~uint32_t(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(chunk, zero)))) & 0xff;
+				const __m128i offsets = _mm_loadu_si128((const __m128i*)NonZeroLut[mask].data());
+				_mm_storeu_si128((__m128i*)(indices + count), _mm_add_epi16(base, offsets));
+				count += _mm_popcnt_u32(mask);
+				base = _mm_add_epi16(base, step);
+			}
+			return count;
+		}
+
+		// >> 6 and clamp to 0..127 - packs saturate per 128 bit lane, the permute puts the outputs back in order
+		_TargetAVX2 static void StoreClamped(__m256i acc0, __m256i acc1, __m256i acc2, __m256i acc3, int8_t* output)
+		{
+			const __m256i packed16a = _mm256_packs_epi32(_mm256_srai_epi32(acc0, 6), _mm256_srai_epi32(acc1, 6));
+			const __m256i packed16b = _mm256_packs_epi32(_mm256_srai_epi32(acc2, 6), _mm256_srai_epi32(acc3, 6));
+			const __m256i packed8 = _mm256_max_epi8(_mm256_packs_epi16(packed16a, packed16b), _mm256_setzero_si256());
+			_mm256_storeu_si256((__m256i*)output, _mm256_permutevar8x32_epi32(packed8, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7)));
+		}
+
+		template<uint32_t inDims>
+		_TargetAVX2 static void Affine(const int8_t* input, int8_t* output, const int32_t* biases, const int8_t* weights)
+		{
+			// 32 outputs → 4 vectors of 8 int32 each
+			__m256i acc0 = _mm256_loadu_si256((const __m256i*)(biases + 0));
+			__m256i acc1 = _mm256_loadu_si256((const __m256i*)(biases + 8));
+			__m256i acc2 = _mm256_loadu_si256((const __m256i*)(biases + 16));
+			__m256i acc3 = _mm256_loadu_si256((const __m256i*)(biases + 24));
+			const __m256i ones = _mm256_set1_epi16(1);
+
+			for (uint32_t idx = 0; idx < inDims; idx += 4) {
+				int32_t group;
+				std::memcpy(&group, input + idx, sizeof(group));
+				const __m256i vinp = _mm256_set1_epi32(group);
+				const int8_t* w = weights + idx * 32;
+
+				acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(_mm256_maddubs_epi16(vinp, _mm256_loadu_si256((const __m256i*)(w + 0))), ones));
+				acc1 = _mm256_add_epi32(acc1, _mm256_madd_epi16(_mm256_maddubs_epi16(vinp, _mm256_loadu_si256((const __m256i*)(w + 32))), ones));
+				acc2 = _mm256_add_epi32(acc2, _mm256_madd_epi16(_mm256_maddubs_epi16(vinp, _mm256_loadu_si256((const __m256i*)(w + 64))), ones));
+				acc3 = _mm256_add_epi32(acc3, _mm256_madd_epi16(_mm256_maddubs_epi16(vinp, _mm256_loadu_si256((const __m256i*)(w + 96))), ones));
+			}
+
+			StoreClamped(acc0, acc1, acc2, acc3, output);
+		}
+
+		template<uint32_t inDims>
+		_TargetAVX2 static void AffineSparse(const int8_t* input, int8_t* output, const int32_t* biases, const int8_t* weights)
+		{
+			uint16_t nonZero[inDims / 4 + 8];
+			const uint32_t count = FindNonZero<inDims>(input, nonZero);
+
+			__m256i acc0 = _mm256_loadu_si256((const __m256i*)(biases + 0));
+			__m256i acc1 = _mm256_loadu_si256((const __m256i*)(biases + 8));
+			__m256i acc2 = _mm256_loadu_si256((const __m256i*)(biases + 16));
+			__m256i acc3 = _mm256_loadu_si256((const __m256i*)(biases + 24));
+			const __m256i ones = _mm256_set1_epi16(1);
+
+			for (uint32_t k = 0; k < count; k++) {
+				const uint32_t idx = nonZero[k] * 4u;
+				int32_t group;
+				std::memcpy(&group, input + idx, sizeof(group));
+				const __m256i vinp = _mm256_set1_epi32(group);
+				const int8_t* w = weights + idx * 32;
+
+				acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(_mm256_maddubs_epi16(vinp, _mm256_loadu_si256((const __m256i*)(w + 0))), ones));
+				acc1 = _mm256_add_epi32(acc1, _mm256_madd_epi16(_mm256_maddubs_epi16(vinp, _mm256_loadu_si256((const __m256i*)(w + 32))), ones));
+				acc2 = _mm256_add_epi32(acc2, _mm256_madd_epi16(_mm256_maddubs_epi16(vinp, _mm256_loadu_si256((const __m256i*)(w + 64))), ones));
+				acc3 = _mm256_add_epi32(acc3, _mm256_madd_epi16(_mm256_maddubs_epi16(vinp, _mm256_loadu_si256((const __m256i*)(w + 96))), ones));
+			}
+
+			StoreClamped(acc0, acc1, acc2, acc3, output);
+		}
+	};
+
+	//gcc's avx512 intrinsics pass a deliberately uninitialized vector as the merge source of unmasked ops
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#endif
+	//512 bit accumulator rows and vpdpbusd for the dense layers. Transform and the zero scan stay on AVX2
+	template<>
+	struct Kernels<Level::AVX512VNNI>
+	{
+		template<uint32_t size>
+		_TargetAVX512VNNI static void AddSub(const int16_t* src, int16_t* dst, const int16_t* const* added, uint8_t addedNum, const int16_t* const* removed, uint8_t removedNum)
+		{
+			constexpr uint32_t Regs = 8;
+			constexpr uint32_t Block = Regs * 32;
+			static_assert(size % Block == 0);
+			for (uint32_t b = 0; b < size; b += Block) {
+				__m512i acc[Regs];
+				for (uint32_t r = 0; r < Regs; r++)
+					acc[r] = src ? _mm512_loadu_si512((const void*)(src + b + r * 32)) : _mm512_setzero_si512();
+
+				for (uint8_t j = 0; j < addedNum; j++) {
+					const int16_t* w = added[j] + b;
+					for (uint32_t r = 0; r < Regs; r++) acc[r] = _mm512_add_epi16(acc[r], _mm512_loadu_si512((const void*)(w + r * 32)));
+				}
+				for (uint8_t j = 0; j < removedNum; j++) {
+					const int16_t* w = removed[j] + b;
+					for (uint32_t r = 0; r < Regs; r++) acc[r] = _mm512_sub_epi16(acc[r], _mm512_loadu_si512((const void*)(w + r * 32)));
+				}
+
+				for (uint32_t r = 0; r < Regs; r++)
+					_mm512_storeu_si512((void*)(dst + b + r * 32), acc[r]);
+			}
+		}
+
+		template<uint32_t size>
+		_TargetAVX512VNNI static void Transform(const int16_t* acc, const int16_t* biases, int8_t* output)
+		{
+			Kernels<Level::AVX2>::Transform<size>(acc, biases, output);
+		}
+
+		template<uint32_t inDims>
+		_TargetAVX512VNNI static uint32_t FindNonZero(const int8_t* input, uint16_t* indices)
+		{
+			return Kernels<Level::AVX2>::FindNonZero<inDims>(input, indices);
+		}
+
+		_TargetAVX512VNNI static void StoreClamped(__m512i lo, __m512i hi, int8_t* output)
+		{
+			Kernels<Level::AVX2>::StoreClamped(_mm512_castsi512_si256(lo), _mm512_extracti64x4_epi64(lo, 1),
+				_mm512_castsi512_si256(hi), _mm512_extracti64x4_epi64(hi, 1), output);
+		}
+
+		//vpdpbusd adds the 4 products of a group without the int16 step - no saturation either
+		template<uint32_t inDims>
+		_TargetAVX512VNNI static void Affine(const int8_t* input, int8_t* output, const int32_t* biases, const int8_t* weights)
+		{
+			__m512i lo = _mm512_loadu_si512((const void*)(biases + 0));
+			__m512i hi = _mm512_loadu_si512((const void*)(biases + 16));
+
+			for (uint32_t idx = 0; idx < inDims; idx += 4) {
+				int32_t group;
+				std::memcpy(&group, input + idx, sizeof(group));
+				const __m512i vinp = _mm512_set1_epi32(group);
+				const int8_t* w = weights + idx * 32;
+
+				lo = _mm512_dpbusd_epi32(lo, vinp, _mm512_loadu_si512((const void*)(w + 0)));
+				hi = _mm512_dpbusd_epi32(hi, vinp, _mm512_loadu_si512((const void*)(w + 64)));
+			}
+
+			StoreClamped(lo, hi, output);
+		}
+
+		template<uint32_t inDims>
+		_TargetAVX512VNNI static void AffineSparse(const int8_t* input, int8_t* output, const int32_t* biases, const int8_t* weights)
+		{
+			uint16_t nonZero[inDims / 4 + 8];
+			const uint32_t count = FindNonZero<inDims>(input, nonZero);
+
+			__m512i lo = _mm512_loadu_si512((const void*)(biases + 0));
+			__m512i hi = _mm512_loadu_si512((const void*)(biases + 16));
+
+			for (uint32_t k = 0; k < count; k++) {
+				const uint32_t idx = nonZero[k] * 4u;
+				int32_t group;
+				std::memcpy(&group, input + idx, sizeof(group));
+				const __m512i vinp = _mm512_set1_epi32(group);
+				const int8_t* w = weights + idx * 32;
+
+				lo = _mm512_dpbusd_epi32(lo, vinp, _mm512_loadu_si512((const void*)(w + 0)));
+				hi = _mm512_dpbusd_epi32(hi, vinp, _mm512_loadu_si512((const void*)(w + 64)));
+			}
+
+			StoreClamped(lo, hi, output);
+		}
+	};
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+}
+}
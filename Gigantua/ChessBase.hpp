@@ -5,12 +5,125 @@
 #include <string_view>
 #include <assert.h>
 #include <array>
+#include <chrono>
+#include <climits>
+#include <algorithm>
 #include "MoveMap.hpp"
+#include "MagicLookup.hpp"
+#include "PextLookup.hpp"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 namespace Gigantua {
 
 	//This is the most important definition for performance!
-	namespace Lookup = ChessLookup::LookupPext;
+	//The move generator is instantiated once per slider backend (MoveList::EnumerateMoves) so the lookups inline into
+	//the hot loop. Everything else goes through the runtime switch in Lookup.
+	//The pext lookups are compiled for bmi2 only - they inline into bmi2 functions and are calls everywhere else
+	struct PextLookup {
+		_TargetBMI2 static uint64_t Rook(int sq, uint64_t occ) { return ChessLookup::LookupBmi2::Rook(sq, occ); }
+		_TargetBMI2 static uint64_t Bishop(int sq, uint64_t occ) { return ChessLookup::LookupBmi2::Bishop(sq, occ); }
+		_TargetBMI2 static uint64_t Queen(int sq, uint64_t occ) { return ChessLookup::LookupBmi2::Queen(sq, occ); }
+		_TargetBMI2 static uint64_t Rook_Xray(int sq, uint64_t occ) { return ChessLookup::LookupBmi2::Rook_Xray(sq, occ); }
+		_TargetBMI2 static uint64_t Bishop_Xray(int sq, uint64_t occ) { return ChessLookup::LookupBmi2::Bishop_Xray(sq, occ); }
+		_ForceInline static uint64_t Knight(int sq) { return ChessLookup::LookupMagic::Knight(sq); }
+		_ForceInline static uint64_t King(int sq) { return ChessLookup::LookupMagic::King(sq); }
+	};
+
+	//Knight and king are plain tables in both
+	struct MagicLookup {
+		_ForceInline static uint64_t Rook(int sq, uint64_t occ) { return ChessLookup::LookupMagic::Rook(sq, occ); }
+		_ForceInline static uint64_t Bishop(int sq, uint64_t occ) { return ChessLookup::LookupMagic::Bishop(sq, occ); }
+		_ForceInline static uint64_t Queen(int sq, uint64_t occ) { return ChessLookup::LookupMagic::Queen(sq, occ); }
+		_ForceInline static uint64_t Rook_Xray(int sq, uint64_t occ) { return ChessLookup::LookupMagic::Rook_Xray(sq, occ); }
+		_ForceInline static uint64_t Bishop_Xray(int sq, uint64_t occ) { return ChessLookup::LookupMagic::Bishop_Xray(sq, occ); }
+		_ForceInline static uint64_t Knight(int sq) { return ChessLookup::LookupMagic::Knight(sq); }
+		_ForceInline static uint64_t King(int sq) { return ChessLookup::LookupMagic::King(sq); }
+	};
+
+	enum class LookupBackend : uint8_t { Pext, Magic };
+
+	namespace Lookup {
+		static constexpr const char* BackendStr(LookupBackend backend) {
+			return backend == LookupBackend::Pext ? "pext" : "magic";
+		}
+
+		inline bool CpuHasBmi2()
+		{
+#if defined(__GNUC__) || defined(__clang__)
+			__builtin_cpu_init();
+			return __builtin_cpu_supports("bmi") && __builtin_cpu_supports("bmi2");
+#else
+			int info[4];
+			__cpuid(info, 0);
+			if (info[0] < 7) return false;
+			__cpuidex(info, 7, 0);
+			return (info[1] & (1 << 3)) && (info[1] & (1 << 8));
+#endif
+		}
+
+		//Nanoseconds for a fixed set of rook and bishop lookups - best of 3
+		template<class TLookup>
+		_ForceInline long long Bench()
+		{
+			long long best = LLONG_MAX;
+			for (int r = 0; r < 3; r++) {
+				uint64_t occ = 0x9E3779B97F4A7C15ull, sink = 0;
+				const auto start = std::chrono::steady_clock::now();
+				for (int i = 0; i < 1 << 14; i++) {
+					occ ^= occ << 13; occ ^= occ >> 7; occ ^= occ << 17;
+					sink += TLookup::Rook(i & 63, occ & (occ >> 9)) ^ TLookup::Bishop((i * 7) & 63, occ & (occ >> 11));
+				}
+				const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+				volatile uint64_t keep = sink; (void)keep;
+				best = std::min<long long>(best, ns);
+			}
+			return best;
+		}
+
+		//Separate so the pext lookups inline into the loop
+		_TargetBMI2 inline long long BenchPext() { return Bench<PextLookup>(); }
+
+		inline long long BenchMagic() { return Bench<MagicLookup>(); }
+
+		namespace detail {
+			inline const bool Bmi2 = CpuHasBmi2();
+		}
+
+		inline bool HasBmi2() { return detail::Bmi2; }
+
+		//Magic without bmi2. With bmi2 whatever is faster here - pext is microcoded on AMD before Zen 3
+		inline LookupBackend Select()
+		{
+			if (!HasBmi2()) return LookupBackend::Magic;
+			return BenchMagic() < BenchPext() ? LookupBackend::Magic : LookupBackend::Pext;
+		}
+
+		namespace detail {
+			inline LookupBackend Active = Select();
+		}
+
+		inline LookupBackend Active() { return detail::Active; }
+
+		//Overrides the startup choice, for benchmarks. Pext is refused without bmi2 - it would fault.
+		//Not while move generation runs on other threads
+		inline bool Force(LookupBackend backend)
+		{
+			if (backend == LookupBackend::Pext && !HasBmi2()) return false;
+			detail::Active = backend;
+			return true;
+		}
+
+		inline uint64_t Rook(int sq, uint64_t occ) { return Active() == LookupBackend::Magic ? MagicLookup::Rook(sq, occ) : PextLookup::Rook(sq, occ); }
+		inline uint64_t Bishop(int sq, uint64_t occ) { return Active() == LookupBackend::Magic ? MagicLookup::Bishop(sq, occ) : PextLookup::Bishop(sq, occ); }
+		inline uint64_t Queen(int sq, uint64_t occ) { return Active() == LookupBackend::Magic ? MagicLookup::Queen(sq, occ) : PextLookup::Queen(sq, occ); }
+		inline uint64_t Rook_Xray(int sq, uint64_t occ) { return Active() == LookupBackend::Magic ? MagicLookup::Rook_Xray(sq, occ) : PextLookup::Rook_Xray(sq, occ); }
+		inline uint64_t Bishop_Xray(int sq, uint64_t occ) { return Active() == LookupBackend::Magic ? MagicLookup::Bishop_Xray(sq, occ) : PextLookup::Bishop_Xray(sq, occ); }
+		_ForceInline uint64_t Knight(int sq) { return MagicLookup::Knight(sq); }
+		_ForceInline uint64_t King(int sq) { return MagicLookup::King(sq); }
+	}
 
 	static constexpr const char* SQSTR[64] = {
 		"h1", "g1", "f1", "e1", "d1", "c1", "b1", "a1",
@@ -32,7 +145,137 @@ namespace Gigantua {
 		BCastleR
 	};
 
+	enum class FenError : uint8_t {
+		None,
+		Placement,
+		SideToMove,
+		Castling,
+		EnPassant,
+		Kings
+	};
+
+	static constexpr const char* FenErrorStr(FenError error) {
+		switch (error) {
+		case FenError::None: return "ok";
+		case FenError::Placement: return "bad piece placement";
+		case FenError::SideToMove: return "bad side to move";
+		case FenError::Castling: return "bad castling rights";
+		case FenError::EnPassant: return "bad en passant square";
+		case FenError::Kings: return "need exactly one king per side";
+		}
+		return "unknown";
+	}
+
+	//Result of FEN::Parse. Bitboards are in the order of the Board constructor: bp bn bb br bq bk wp wn wb wr wq wk
+	struct FenPosition {
+		std::array<uint64_t, 12> bits{};
+		bool white = true;
+		bool wCastleL = false, wCastleR = false, bCastleL = false, bCastleR = false;
+		uint64_t enPassant = 0;
+		uint16_t halfMove = 0;
+		uint16_t fullMove = 1;
+		size_t length = 0; //Chars consumed - EPD operations start here. On error the offset of the bad char
+	};
+
 	struct FEN {
+		//Index into FenPosition::bits or -1
+		static constexpr int PieceIndex(char c) {
+			switch (c) {
+			case 'p': return 0; case 'n': return 1; case 'b': return 2; case 'r': return 3; case 'q': return 4; case 'k': return 5;
+			case 'P': return 6; case 'N': return 7; case 'B': return 8; case 'R': return 9; case 'Q': return 10; case 'K': return 11;
+			default: return -1;
+			}
+		}
+
+		/// Single pass over the four FEN fields and the optional move counters. Does not allocate.
+		/// Trailing text (EPD operations) is left alone and starts at pos.length
+		static constexpr FenError Parse(std::string_view fen, FenPosition& pos)
+		{
+			pos = FenPosition{};
+			const size_t n = fen.size();
+			size_t i = 0;
+
+			auto fail = [&](FenError error) { pos.length = i; return error; };
+			auto skipSpace = [&]() { while (i < n && (fen[i] == ' ' || fen[i] == '\t')) i++; };
+			auto nextField = [&]() {
+				if (i >= n || (fen[i] != ' ' && fen[i] != '\t')) return false;
+				skipSpace();
+				return i < n;
+			};
+
+			skipSpace();
+
+			//Placement from a8 to h1
+			int rank = 7, file = 0;
+			for (; i < n && fen[i] != ' ' && fen[i] != '\t'; i++) {
+				const char c = fen[i];
+				if (c == '/') {
+					if (file != 8 || rank == 0) return fail(FenError::Placement);
+					rank--;
+					file = 0;
+				}
+				else if (c >= '1' && c <= '8') {
+					file += c - '0';
+					if (file > 8) return fail(FenError::Placement);
+				}
+				else {
+					const int piece = PieceIndex(c);
+					if (piece < 0 || file > 7) return fail(FenError::Placement);
+					pos.bits[piece] |= 1ull << (rank * 8 + 7 - file);
+					file++;
+				}
+			}
+			if (rank != 0 || file != 8) return fail(FenError::Placement);
+			auto single = [](uint64_t bits) { return bits && !(bits & (bits - 1)); };
+			if (!single(pos.bits[5]) || !single(pos.bits[11])) return fail(FenError::Kings);
+
+			if (!nextField()) return fail(FenError::SideToMove);
+			if (fen[i] == 'w') pos.white = true;
+			else if (fen[i] == 'b') pos.white = false;
+			else return fail(FenError::SideToMove);
+			i++;
+
+			if (!nextField()) return fail(FenError::Castling);
+			if (fen[i] == '-') i++;
+			else for (; i < n && fen[i] != ' ' && fen[i] != '\t'; i++) {
+				switch (fen[i]) {
+				case 'K': pos.wCastleR = true; break;
+				case 'Q': pos.wCastleL = true; break;
+				case 'k': pos.bCastleR = true; break;
+				case 'q': pos.bCastleL = true; break;
+				default: return fail(FenError::Castling);
+				}
+			}
+
+			//En passant target is stored as the square of the pawn that can be taken
+			if (!nextField()) return fail(FenError::EnPassant);
+			if (fen[i] == '-') i++;
+			else {
+				if (i + 1 >= n || fen[i] < 'a' || fen[i] > 'h' || fen[i + 1] != (pos.white ? '6' : '3')) return fail(FenError::EnPassant);
+				pos.enPassant = 1ull << ((pos.white ? 32 : 24) + ('h' - fen[i]));
+				i += 2;
+			}
+			if (i < n && fen[i] != ' ' && fen[i] != '\t') return fail(FenError::EnPassant);
+
+			//Optional halfmove and fullmove counters
+			for (int counter = 0; counter < 2; counter++) {
+				size_t j = i;
+				while (j < n && (fen[j] == ' ' || fen[j] == '\t')) j++;
+				if (j == i || j >= n || fen[j] < '0' || fen[j] > '9') break;
+
+				uint32_t value = 0;
+				for (; j < n && fen[j] >= '0' && fen[j] <= '9'; j++) value = value * 10 + (fen[j] - '0');
+				if (j < n && fen[j] != ' ' && fen[j] != '\t' && fen[j] != ';') break;
+
+				if (counter == 0) pos.halfMove = uint16_t(value);
+				else pos.fullMove = uint16_t(value);
+				i = j;
+			}
+
+			pos.length = i;
+			return FenError::None;
+		}
+
 		static constexpr uint64_t FenEnpassant(std::string_view FEN) {
 			uint64_t i = 0;
 
@@ -218,6 +461,9 @@ namespace Gigantua {
 			FEN::FenEnpassant(fen))
 		{}
 
+		BoardStatus(const FenPosition& pos) : BoardStatus(pos.white, pos.wCastleL, pos.wCastleR, pos.bCastleL, pos.bCastleR, pos.enPassant)
+		{}
+
 		friend bool operator==(const BoardStatus& lhs, const BoardStatus& rhs) { return lhs.status == rhs.status; }
 		friend bool operator!=(const BoardStatus& lhs, const BoardStatus& rhs) { return lhs.status != rhs.status; }
 
@@ -351,6 +597,50 @@ namespace Gigantua {
 		QueenMovePromote
 	};
 
+	//Piece-square hashing. Board::Move::play only xors the keys that change instead of rehashing all bitboards
+	struct Zobrist {
+	private:
+		static constexpr size_t PieceKeys = 12 * 64;
+		static constexpr size_t CastleKeys = 16;
+		static constexpr size_t EnPassantKeys = 16; //EnPassantTarget() lives on bits 24..39
+
+		//splitmix64 sequence, generated at compile time
+		static constexpr std::array<uint64_t, PieceKeys + CastleKeys + EnPassantKeys + 1> Keys = []() {
+			std::array<uint64_t, PieceKeys + CastleKeys + EnPassantKeys + 1> keys{};
+			uint64_t state = 0x1b96ed4a75ba0db8ull;
+			for (auto& k : keys) {
+				uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+				z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+				z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+				k = z ^ (z >> 31);
+			}
+			return keys;
+		}();
+
+	public:
+		template<BoardPiece piece, bool IsWhite>
+		static _ForceInline uint64_t Piece(uint8_t sq) {
+			return Keys[((IsWhite ? 6 : 0) + int(piece)) * 64 + sq];
+		}
+
+		//All squares of a bitboard - used for full hashing and for from|to masks
+		template<BoardPiece piece, bool IsWhite>
+		static _ForceInline uint64_t Squares(uint64_t bits) {
+			uint64_t hash = 0;
+			Bitloop(bits) {
+				hash ^= Piece<piece, IsWhite>(SquareOf(bits));
+			}
+			return hash;
+		}
+
+		static _ForceInline uint64_t Status(BoardStatus status) {
+			const uint64_t value = status.Value();
+			uint64_t hash = Keys[PieceKeys + ((value >> 1) & 0b1111)];
+			if (status.EnPassantTarget()) hash ^= Keys[PieceKeys + CastleKeys + SquareOf(status.EnPassantTarget()) - 24];
+			if (status.WhiteMove()) hash ^= Keys[PieceKeys + CastleKeys + EnPassantKeys];
+			return hash;
+		}
+	};
 
 	struct Board {
 		uint64_t BPawn = 0;
@@ -371,6 +661,16 @@ namespace Gigantua {
 
 		uint64_t Hash = 0;
 
+#ifdef MAILBOX_SUPPORT
+		//Piece code per square: BoardPiece | 8 for white pieces, BoardPiece::None on empty squares
+		std::array<uint8_t, 64> Mailbox;
+#endif
+
+		static constexpr uint8_t MailboxEmpty = uint8_t(BoardPiece::None);
+
+		template<BoardPiece piece, bool IsWhite>
+		_Compiletime uint8_t MailboxCode() { return uint8_t(piece) | (IsWhite ? 8 : 0); }
+
 		static uint64_t cell(int8_t x, int8_t y) {
 			if (x < 0 || y < 0 || x > 7 || y > 7) return 0ull;
 
@@ -383,7 +683,11 @@ namespace Gigantua {
 
 		static constexpr uint64_t DarkSquares = 0x55aa55aa55aa55aaull;
 
-		Board() {}
+		Board() {
+#ifdef MAILBOX_SUPPORT
+			Mailbox.fill(MailboxEmpty);
+#endif
+		}
 
 		Board(
 			uint64_t bp, uint64_t bn, uint64_t bb, uint64_t br, uint64_t bq, uint64_t bk,
@@ -392,31 +696,56 @@ namespace Gigantua {
 			WPawn(wp), WKnight(wn), WBishop(wb), WRook(wr), WQueen(wq), WKing(wk),
 			status(st)
 		{
-			Hash = BPawn * 0x0ea77a98b5a86659ull;
-			Hash ^= BKnight * 0xb501bce657c8a33aull;
-			Hash ^= BBishop * 0xfe204f09d21696b4ull;
-			Hash ^= BRook * 0x1c1d761faacf8548ull;
-			Hash ^= BQueen * 0xd166dc9059f73ca6ull;
-			Hash ^= BKing * 0x3234a26e1484b3d0ull;
-
-			Hash ^= WPawn * 0xc7628097fc96e72cull;
-			Hash ^= WKnight * 0xdcc28057e306a015ull;
-			Hash ^= WBishop * 0xb11fcb5fabdfbeb2ull;
-			Hash ^= WRook * 0xd047c0d37f7c414dull;
-			Hash ^= WQueen * 0x04e8ab76cca34dc4ull;
-			Hash ^= WKing * 0x304052e4bbbff0eaull;
-			Hash ^= status.Value() * 0x1b96ed4a75ba0db8ull;
-
-			Hash = (Hash ^ (Hash >> 30)) * 0xbf58476d1ce4e5b9ull;
-			Hash = (Hash ^ (Hash >> 27)) * 0x94d049bb133111ebull;
-			Hash = Hash ^ (Hash >> 31);
-		}
-
-		Board(std::string_view FEN) :
-			Board(FEN::FenToBmp(FEN, 'p'), FEN::FenToBmp(FEN, 'n'), FEN::FenToBmp(FEN, 'b'), FEN::FenToBmp(FEN, 'r'), FEN::FenToBmp(FEN, 'q'), FEN::FenToBmp(FEN, 'k'),
-				FEN::FenToBmp(FEN, 'P'), FEN::FenToBmp(FEN, 'N'), FEN::FenToBmp(FEN, 'B'), FEN::FenToBmp(FEN, 'R'), FEN::FenToBmp(FEN, 'Q'), FEN::FenToBmp(FEN, 'K'),
-				FEN)
+			Hash = Zobrist::Squares<BoardPiece::Pawn, false>(BPawn);
+			Hash ^= Zobrist::Squares<BoardPiece::Knight, false>(BKnight);
+			Hash ^= Zobrist::Squares<BoardPiece::Bishop, false>(BBishop);
+			Hash ^= Zobrist::Squares<BoardPiece::Rook, false>(BRook);
+			Hash ^= Zobrist::Squares<BoardPiece::Queen, false>(BQueen);
+			Hash ^= Zobrist::Squares<BoardPiece::King, false>(BKing);
+
+			Hash ^= Zobrist::Squares<BoardPiece::Pawn, true>(WPawn);
+			Hash ^= Zobrist::Squares<BoardPiece::Knight, true>(WKnight);
+			Hash ^= Zobrist::Squares<BoardPiece::Bishop, true>(WBishop);
+			Hash ^= Zobrist::Squares<BoardPiece::Rook, true>(WRook);
+			Hash ^= Zobrist::Squares<BoardPiece::Queen, true>(WQueen);
+			Hash ^= Zobrist::Squares<BoardPiece::King, true>(WKing);
+			Hash ^= Zobrist::Status(status);
+
+#ifdef MAILBOX_SUPPORT
+			for (uint8_t sq = 0; sq < 64; sq++) Mailbox[sq] = uint8_t(PieceOnBits(sq)) | ((White() >> sq) & 1ull ? 8 : 0);
+#endif
+		}
+
+		//Hash is taken as given: the move functions pass the incrementally updated key.
+		//Passing 0 skips hashing for throwaway boards (perft leaves) - such a board must not be stored or compared
+		//The mailbox is left to the caller: the move functions copy and patch it from the previous board
+		Board(
+			uint64_t bp, uint64_t bn, uint64_t bb, uint64_t br, uint64_t bq, uint64_t bk,
+			uint64_t wp, uint64_t wn, uint64_t wb, uint64_t wr, uint64_t wq, uint64_t wk, BoardStatus st, uint64_t hash) :
+			BPawn(bp), BKnight(bn), BBishop(bb), BRook(br), BQueen(bq), BKing(bk),
+			WPawn(wp), WKnight(wn), WBishop(wb), WRook(wr), WQueen(wq), WKing(wk),
+			status(st), Hash(hash)
+		{
+		}
+
+		Board(const FenPosition& pos) :
+			Board(pos.bits[0], pos.bits[1], pos.bits[2], pos.bits[3], pos.bits[4], pos.bits[5],
+				pos.bits[6], pos.bits[7], pos.bits[8], pos.bits[9], pos.bits[10], pos.bits[11], BoardStatus(pos))
+		{
+		}
+
+		//Malformed input asserts in debug - use FromFen to get the error instead
+		Board(std::string_view FEN) : Board(ParseFen(FEN))
+		{
+		}
+
+		//Leaves brd untouched on error
+		static FenError FromFen(std::string_view fen, Board& brd)
 		{
+			FenPosition pos;
+			const FenError error = FEN::Parse(fen, pos);
+			if (error == FenError::None) brd = Board(pos);
+			return error;
 		}
 
 		bool IsNull() const
@@ -424,6 +753,29 @@ namespace Gigantua {
 			return Hash == 0ull;
 		}
 
+		//Piece on a square of either color by testing the bitboards
+		BoardPiece PieceOnBits(uint8_t sq) const
+		{
+			const uint64_t cell = 1ull << sq;
+			if ((WPawn | BPawn) & cell) return BoardPiece::Pawn;
+			if ((WKnight | BKnight) & cell) return BoardPiece::Knight;
+			if ((WBishop | BBishop) & cell) return BoardPiece::Bishop;
+			if ((WRook | BRook) & cell) return BoardPiece::Rook;
+			if ((WQueen | BQueen) & cell) return BoardPiece::Queen;
+			if ((WKing | BKing) & cell) return BoardPiece::King;
+			return BoardPiece::None;
+		}
+
+		//Piece on a square of either color - a single load with MAILBOX_SUPPORT
+		_ForceInline BoardPiece PieceOn(uint8_t sq) const
+		{
+#ifdef MAILBOX_SUPPORT
+			return BoardPiece(Mailbox[sq] & 7);
+#else
+			return PieceOnBits(sq);
+#endif
+		}
+
 		Board Mirror() const
 		{
 			return Board(ReverseBits(WPawn), ReverseBits(WKnight), ReverseBits(WBishop), ReverseBits(WRook), ReverseBits(WQueen), ReverseBits(WKing),
@@ -473,6 +825,9 @@ namespace Gigantua {
 
 			BoardPiece who(const Board& brd) const
 			{
+#ifdef MAILBOX_SUPPORT
+				return brd.PieceOn(from());
+#else
 				const uint64_t cell = (1ull << from()); 
 				if constexpr (white) {
 					if (brd.WPawn & cell) return BoardPiece::Pawn;
@@ -492,12 +847,15 @@ namespace Gigantua {
 				}
 
 				return BoardPiece::None;
+#endif
 			}
 
 			BoardPiece captured(const Board& brd) const
 			{
 				if (type() == MoveType::PawnEnpassantTake) return BoardPiece::Pawn;
-
+#ifdef MAILBOX_SUPPORT
+				return brd.PieceOn(to());
+#else
 				const uint64_t cell = (1ull << to()); 
 				if constexpr (white) {
 					if (brd.BPawn & cell) return BoardPiece::Pawn;
@@ -515,6 +873,7 @@ namespace Gigantua {
 				}
 
 				return BoardPiece::None;
+#endif
 			}
 
 			bool isQueenPromote() const
@@ -530,28 +889,30 @@ namespace Gigantua {
 				return false;
 			}
 
+			//UpdateHash = false builds a board without a key or mailbox for callers that never read them (leaf counting)
+			template<bool UpdateHash = true>
 			Board play(const Board& brd) const
 			{
 				switch (type())
 				{
 				case MoveType::KingMove:
-					return Board::PieceMove<BoardPiece::King, white>(brd, brd.status.KingMove(), 1ull << from(), 1ull << to());
+					return Board::PieceMove<BoardPiece::King, white, UpdateHash>(brd, brd.status.KingMove(), 1ull << from(), 1ull << to());
 				case MoveType::KingCastleLeft:
-					return Board::MoveCastle<white>(brd, brd.status.KingMove(), (1ull << from()) | (1ull << to()), brd.status.Castle_RookswitchL());
+					return Board::MoveCastle<white, UpdateHash>(brd, brd.status.KingMove(), (1ull << from()) | (1ull << to()), brd.status.Castle_RookswitchL());
 				case MoveType::KingCastleRight:
-					return Board::MoveCastle<white>(brd, brd.status.KingMove(), (1ull << from()) | (1ull << to()), brd.status.Castle_RookswitchR());
+					return Board::MoveCastle<white, UpdateHash>(brd, brd.status.KingMove(), (1ull << from()) | (1ull << to()), brd.status.Castle_RookswitchR());
 				case MoveType::PawnMove:
-					return Board::PieceMove<BoardPiece::Pawn, white, false>(brd, brd.status.SilentMove(), 1ull << from(), 1ull << to());
+					return Board::PieceMove<BoardPiece::Pawn, white, false, UpdateHash>(brd, brd.status.SilentMove(), 1ull << from(), 1ull << to());
 				case MoveType::PawnAtk:
-					return Board::PieceMove<BoardPiece::Pawn, white, true>(brd, brd.status.SilentMove(), 1ull << from(), 1ull << to());
+					return Board::PieceMove<BoardPiece::Pawn, white, true, UpdateHash>(brd, brd.status.SilentMove(), 1ull << from(), 1ull << to());
 				case MoveType::PawnEnpassantTake:
-					return Board::MoveEP<white>(brd, brd.status.SilentMove(), 1ull << from(), 1ull << to());
+					return Board::MoveEP<white, UpdateHash>(brd, brd.status.SilentMove(), 1ull << from(), 1ull << to());
 				case MoveType::PawnPush:
-					return Board::PieceMove<BoardPiece::Pawn, white, false>(brd, brd.status.PawnPush(1ull << to()), 1ull << from(), 1ull << to());
+					return Board::PieceMove<BoardPiece::Pawn, white, false, UpdateHash>(brd, brd.status.PawnPush(1ull << to()), 1ull << from(), 1ull << to());
 				case MoveType::KnightMove:
-					return Board::PieceMove<BoardPiece::Knight, white>(brd, brd.status.SilentMove(), 1ull << from(), 1ull << to());
+					return Board::PieceMove<BoardPiece::Knight, white, UpdateHash>(brd, brd.status.SilentMove(), 1ull << from(), 1ull << to());
 				case MoveType::BishopMove:
-					return Board::PieceMove<BoardPiece::Bishop, white>(brd, brd.status.SilentMove(), 1ull << Move<white>::from(), 1ull << Move<white>::to());
+					return Board::PieceMove<BoardPiece::Bishop, white, UpdateHash>(brd, brd.status.SilentMove(), 1ull << Move<white>::from(), 1ull << Move<white>::to());
 				case MoveType::RookMove:
 				{
 					BoardStatus newStatus = brd.status.SilentMove();
@@ -566,18 +927,18 @@ namespace Gigantua {
 						}
 					}
 
-					return Board::PieceMove<BoardPiece::Rook, white>(brd, newStatus, 1ull << from(), 1ull << to());
+					return Board::PieceMove<BoardPiece::Rook, white, UpdateHash>(brd, newStatus, 1ull << from(), 1ull << to());
 				}
 				case MoveType::QueenMove:
-					return Board::PieceMove<BoardPiece::Queen, white>(brd, brd.status.SilentMove(), 1ull << from(), 1ull << to());
+					return Board::PieceMove<BoardPiece::Queen, white, UpdateHash>(brd, brd.status.SilentMove(), 1ull << from(), 1ull << to());
 				case MoveType::KnightMovePromote:
-					return Board::PieceMovePromote<BoardPiece::Knight, white>(brd, brd.status.SilentMove(), 1ull << from(), 1ull << to());
+					return Board::PieceMovePromote<BoardPiece::Knight, white, UpdateHash>(brd, brd.status.SilentMove(), 1ull << from(), 1ull << to());
 				case MoveType::BishopMovePromote:
-					return Board::PieceMovePromote<BoardPiece::Bishop, white>(brd, brd.status.SilentMove(), 1ull << from(), 1ull << to());
+					return Board::PieceMovePromote<BoardPiece::Bishop, white, UpdateHash>(brd, brd.status.SilentMove(), 1ull << from(), 1ull << to());
 				case MoveType::RookMovePromote:
-					return Board::PieceMovePromote<BoardPiece::Rook, white>(brd, brd.status.SilentMove(), 1ull << from(), 1ull << to());
+					return Board::PieceMovePromote<BoardPiece::Rook, white, UpdateHash>(brd, brd.status.SilentMove(), 1ull << from(), 1ull << to());
 				case MoveType::QueenMovePromote:
-					return Board::PieceMovePromote<BoardPiece::Queen, white>(brd, brd.status.SilentMove(), 1ull << from(), 1ull << to());
+					return Board::PieceMovePromote<BoardPiece::Queen, white, UpdateHash>(brd, brd.status.SilentMove(), 1ull << from(), 1ull << to());
 				default:
 					break;
 				}
@@ -673,9 +1034,42 @@ namespace Gigantua {
 			return from != 0ull && to != 0ull && from != to;
 		}
 
-		template<BoardPiece piece, bool IsWhite>
+		//Key of the enemy piece standing on 'to' - 0 for a quiet move
+		template<bool IsWhite>
+		static _ForceInline uint64_t CaptureKey(const Board& existing, uint64_t to)
+		{
+			const uint8_t sq = SquareOf(to);
+			if constexpr (IsWhite) {
+				if (existing.BPawn & to) return Zobrist::Piece<BoardPiece::Pawn, false>(sq);
+				if (existing.BKnight & to) return Zobrist::Piece<BoardPiece::Knight, false>(sq);
+				if (existing.BBishop & to) return Zobrist::Piece<BoardPiece::Bishop, false>(sq);
+				if (existing.BRook & to) return Zobrist::Piece<BoardPiece::Rook, false>(sq);
+				if (existing.BQueen & to) return Zobrist::Piece<BoardPiece::Queen, false>(sq);
+			}
+			else {
+				if (existing.WPawn & to) return Zobrist::Piece<BoardPiece::Pawn, true>(sq);
+				if (existing.WKnight & to) return Zobrist::Piece<BoardPiece::Knight, true>(sq);
+				if (existing.WBishop & to) return Zobrist::Piece<BoardPiece::Bishop, true>(sq);
+				if (existing.WRook & to) return Zobrist::Piece<BoardPiece::Rook, true>(sq);
+				if (existing.WQueen & to) return Zobrist::Piece<BoardPiece::Queen, true>(sq);
+			}
+			return 0;
+		}
+
+		static _ForceInline uint64_t StatusKey(const Board& existing, BoardStatus newStatus)
+		{
+			return Zobrist::Status(existing.status) ^ Zobrist::Status(newStatus);
+		}
+
+		template<BoardPiece piece, bool IsWhite, bool UpdateHash = true>
 		static Board PieceMovePromote(const Board& existing, BoardStatus newStatus, uint64_t from, uint64_t to)
 		{
+			uint64_t hash = 0;
+			if constexpr (UpdateHash) {
+				hash = existing.Hash ^ StatusKey(existing, newStatus) ^ CaptureKey<IsWhite>(existing, to)
+					^ Zobrist::Piece<BoardPiece::Pawn, IsWhite>(SquareOf(from)) ^ Zobrist::Piece<piece, IsWhite>(SquareOf(to));
+			}
+
 			const uint64_t rem = ~to;
 			const uint64_t bp = existing.BPawn;
 			const uint64_t bn = existing.BKnight;
@@ -691,24 +1085,40 @@ namespace Gigantua {
 			const uint64_t wq = existing.WQueen;
 			const uint64_t wk = existing.WKing;
 
+			Board next;
 			if constexpr (IsWhite) {
-				if constexpr (BoardPiece::Queen == piece)  return Board(bp & rem, bn & rem, bb & rem, br & rem, bq & rem, bk, wp ^ from, wn, wb, wr, wq ^ to, wk, newStatus);
-				if constexpr (BoardPiece::Rook == piece)   return Board(bp & rem, bn & rem, bb & rem, br & rem, bq & rem, bk, wp ^ from, wn, wb, wr ^ to, wq, wk, newStatus);
-				if constexpr (BoardPiece::Bishop == piece) return Board(bp & rem, bn & rem, bb & rem, br & rem, bq & rem, bk, wp ^ from, wn, wb ^ to, wr, wq, wk, newStatus);
-				if constexpr (BoardPiece::Knight == piece) return Board(bp & rem, bn & rem, bb & rem, br & rem, bq & rem, bk, wp ^ from, wn ^ to, wb, wr, wq, wk, newStatus);
+				if constexpr (BoardPiece::Queen == piece)  next = Board(bp & rem, bn & rem, bb & rem, br & rem, bq & rem, bk, wp ^ from, wn, wb, wr, wq ^ to, wk, newStatus, hash);
+				if constexpr (BoardPiece::Rook == piece)   next = Board(bp & rem, bn & rem, bb & rem, br & rem, bq & rem, bk, wp ^ from, wn, wb, wr ^ to, wq, wk, newStatus, hash);
+				if constexpr (BoardPiece::Bishop == piece) next = Board(bp & rem, bn & rem, bb & rem, br & rem, bq & rem, bk, wp ^ from, wn, wb ^ to, wr, wq, wk, newStatus, hash);
+				if constexpr (BoardPiece::Knight == piece) next = Board(bp & rem, bn & rem, bb & rem, br & rem, bq & rem, bk, wp ^ from, wn ^ to, wb, wr, wq, wk, newStatus, hash);
 			}
 			else {
-				if constexpr (BoardPiece::Queen == piece)  return Board(bp ^ from, bn, bb, br, bq ^ to, bk, wp & rem, wn & rem, wb & rem, wr & rem, wq & rem, wk, newStatus);
-				if constexpr (BoardPiece::Rook == piece)   return Board(bp ^ from, bn, bb, br ^ to, bq, bk, wp & rem, wn & rem, wb & rem, wr & rem, wq & rem, wk, newStatus);
-				if constexpr (BoardPiece::Bishop == piece) return Board(bp ^ from, bn, bb ^ to, br, bq, bk, wp & rem, wn & rem, wb & rem, wr & rem, wq & rem, wk, newStatus);
-				if constexpr (BoardPiece::Knight == piece) return Board(bp ^ from, bn ^ to, bb, br, bq, bk, wp & rem, wn & rem, wb & rem, wr & rem, wq & rem, wk, newStatus);
+				if constexpr (BoardPiece::Queen == piece)  next = Board(bp ^ from, bn, bb, br, bq ^ to, bk, wp & rem, wn & rem, wb & rem, wr & rem, wq & rem, wk, newStatus, hash);
+				if constexpr (BoardPiece::Rook == piece)   next = Board(bp ^ from, bn, bb, br ^ to, bq, bk, wp & rem, wn & rem, wb & rem, wr & rem, wq & rem, wk, newStatus, hash);
+				if constexpr (BoardPiece::Bishop == piece) next = Board(bp ^ from, bn, bb ^ to, br, bq, bk, wp & rem, wn & rem, wb & rem, wr & rem, wq & rem, wk, newStatus, hash);
+				if constexpr (BoardPiece::Knight == piece) next = Board(bp ^ from, bn ^ to, bb, br, bq, bk, wp & rem, wn & rem, wb & rem, wr & rem, wq & rem, wk, newStatus, hash);
+			}
+
+#ifdef MAILBOX_SUPPORT
+			if constexpr (UpdateHash) {
+				next.Mailbox = existing.Mailbox;
+				next.Mailbox[SquareOf(from)] = MailboxEmpty;
+				next.Mailbox[SquareOf(to)] = MailboxCode<piece, IsWhite>();
 			}
+#endif
+			return next;
 		}
 
 		//Todo: elegant not code duplication for Castling
-		template<bool IsWhite>
+		template<bool IsWhite, bool UpdateHash = true>
 		static Board MoveCastle(const Board& existing, BoardStatus newStatus, uint64_t kingswitch, uint64_t rookswitch)
 		{
+			uint64_t hash = 0;
+			if constexpr (UpdateHash) {
+				hash = existing.Hash ^ StatusKey(existing, newStatus)
+					^ Zobrist::Squares<BoardPiece::King, IsWhite>(kingswitch) ^ Zobrist::Squares<BoardPiece::Rook, IsWhite>(rookswitch);
+			}
+
 			const uint64_t bp = existing.BPawn;
 			const uint64_t bn = existing.BKnight;
 			const uint64_t bb = existing.BBishop;
@@ -723,20 +1133,40 @@ namespace Gigantua {
 			const uint64_t wq = existing.WQueen;
 			const uint64_t wk = existing.WKing;
 
+			Board next;
 			if constexpr (IsWhite) {
-				return Board(bp, bn, bb, br, bq, bk, wp, wn, wb, wr ^ rookswitch, wq, wk ^ kingswitch, newStatus);
+				next = Board(bp, bn, bb, br, bq, bk, wp, wn, wb, wr ^ rookswitch, wq, wk ^ kingswitch, newStatus, hash);
 			}
 			else {
-				return Board(bp, bn, bb, br ^ rookswitch, bq, bk ^ kingswitch, wp, wn, wb, wr, wq, wk, newStatus);
+				next = Board(bp, bn, bb, br ^ rookswitch, bq, bk ^ kingswitch, wp, wn, wb, wr, wq, wk, newStatus, hash);
+			}
+
+#ifdef MAILBOX_SUPPORT
+			if constexpr (UpdateHash) {
+				const uint64_t king = King<IsWhite>(existing);
+				const uint64_t rook = rookswitch & existing.Occ();
+				next.Mailbox = existing.Mailbox;
+				next.Mailbox[SquareOf(king)] = MailboxEmpty;
+				next.Mailbox[SquareOf(rook)] = MailboxEmpty;
+				next.Mailbox[SquareOf(kingswitch ^ king)] = MailboxCode<BoardPiece::King, IsWhite>();
+				next.Mailbox[SquareOf(rookswitch ^ rook)] = MailboxCode<BoardPiece::Rook, IsWhite>();
 			}
+#endif
+			return next;
 		}
 
 		//Todo: elegant not code duplication for EP taking. Where to and rem are different squares
-		template<bool IsWhite>
+		template<bool IsWhite, bool UpdateHash = true>
 		static Board MoveEP(const Board& existing, BoardStatus newStatus, uint64_t from, uint64_t to)
 		{
 			const uint64_t enemy = IsWhite ? to >> 8 : to << 8;
 
+			uint64_t hash = 0;
+			if constexpr (UpdateHash) {
+				hash = existing.Hash ^ StatusKey(existing, newStatus) ^ Zobrist::Piece<BoardPiece::Pawn, !IsWhite>(SquareOf(enemy))
+					^ Zobrist::Piece<BoardPiece::Pawn, IsWhite>(SquareOf(from)) ^ Zobrist::Piece<BoardPiece::Pawn, IsWhite>(SquareOf(to));
+			}
+
 
 			const uint64_t rem = ~enemy;
 			const uint64_t bp = existing.BPawn;
@@ -755,24 +1185,42 @@ namespace Gigantua {
 			const uint64_t mov = from | to;
 
 
+			Board next;
 			if constexpr (IsWhite) {
-				return Board(bp & rem, bn, bb, br, bq, bk, wp ^ mov, wn, wb, wr, wq, wk, newStatus);
+				next = Board(bp & rem, bn, bb, br, bq, bk, wp ^ mov, wn, wb, wr, wq, wk, newStatus, hash);
 			}
 			else {
-				return Board(bp ^ mov, bn, bb, br, bq, bk, wp & rem, wn, wb, wr, wq, wk, newStatus);
+				next = Board(bp ^ mov, bn, bb, br, bq, bk, wp & rem, wn, wb, wr, wq, wk, newStatus, hash);
+			}
+
+#ifdef MAILBOX_SUPPORT
+			if constexpr (UpdateHash) {
+				next.Mailbox = existing.Mailbox;
+				next.Mailbox[SquareOf(from)] = MailboxEmpty;
+				next.Mailbox[SquareOf(enemy)] = MailboxEmpty;
+				next.Mailbox[SquareOf(to)] = MailboxCode<BoardPiece::Pawn, IsWhite>();
 			}
+#endif
+			return next;
 		}
 
-		template<BoardPiece piece, bool IsWhite>
+		template<BoardPiece piece, bool IsWhite, bool UpdateHash = true>
 		static Board PieceMove(const Board& existing, BoardStatus newStatus, uint64_t from, uint64_t to)
 		{
-			if (to & Enemy<IsWhite>(existing)) return PieceMove<piece, IsWhite, true>(existing, newStatus, from, to);
-			else return PieceMove<piece, IsWhite, false>(existing, newStatus, from, to);
+			if (to & Enemy<IsWhite>(existing)) return PieceMove<piece, IsWhite, true, UpdateHash>(existing, newStatus, from, to);
+			else return PieceMove<piece, IsWhite, false, UpdateHash>(existing, newStatus, from, to);
 		}
 
-		template<BoardPiece piece, bool IsWhite, bool IsTaking>
+		template<BoardPiece piece, bool IsWhite, bool IsTaking, bool UpdateHash>
 		static Board PieceMove(const Board& existing, BoardStatus newStatus, uint64_t from, uint64_t to)
 		{
+			uint64_t hash = 0;
+			if constexpr (UpdateHash) {
+				hash = existing.Hash ^ StatusKey(existing, newStatus)
+					^ Zobrist::Piece<piece, IsWhite>(SquareOf(from)) ^ Zobrist::Piece<piece, IsWhite>(SquareOf(to));
+				if constexpr (IsTaking) hash ^= CaptureKey<IsWhite>(existing, to);
+			}
+
 			const uint64_t bp = existing.BPawn;
 			const uint64_t bn = existing.BKnight;
 			const uint64_t bb = existing.BBishop;
@@ -789,56 +1237,77 @@ namespace Gigantua {
 
 			const uint64_t mov = from | to;
 
+			Board next;
 			if constexpr (IsTaking)
 			{
 				const uint64_t rem = ~to;
 				if constexpr (IsWhite) {
 					assert((bk & mov) == 0 && "Taking Black King is not legal!");
 					assert((to & existing.White()) == 0 && "Cannot move to square of same white color!");
-					if constexpr (BoardPiece::Pawn == piece)    return Board(bp & rem, bn & rem, bb & rem, br & rem, bq & rem, bk, wp ^ mov, wn, wb, wr, wq, wk, newStatus);
-					if constexpr (BoardPiece::Knight == piece)  return Board(bp & rem, bn & rem, bb & rem, br & rem, bq & rem, bk, wp, wn ^ mov, wb, wr, wq, wk, newStatus);
-					if constexpr (BoardPiece::Bishop == piece)  return Board(bp & rem, bn & rem, bb & rem, br & rem, bq & rem, bk, wp, wn, wb ^ mov, wr, wq, wk, newStatus);
-					if constexpr (BoardPiece::Rook == piece)    return Board(bp & rem, bn & rem, bb & rem, br & rem, bq & rem, bk, wp, wn, wb, wr ^ mov, wq, wk, newStatus);
-					if constexpr (BoardPiece::Queen == piece)   return Board(bp & rem, bn & rem, bb & rem, br & rem, bq & rem, bk, wp, wn, wb, wr, wq ^ mov, wk, newStatus);
-					if constexpr (BoardPiece::King == piece)    return Board(bp & rem, bn & rem, bb & rem, br & rem, bq & rem, bk, wp, wn, wb, wr, wq, wk ^ mov, newStatus);
+					if constexpr (BoardPiece::Pawn == piece)    next = Board(bp & rem, bn & rem, bb & rem, br & rem, bq & rem, bk, wp ^ mov, wn, wb, wr, wq, wk, newStatus, hash);
+					if constexpr (BoardPiece::Knight == piece)  next = Board(bp & rem, bn & rem, bb & rem, br & rem, bq & rem, bk, wp, wn ^ mov, wb, wr, wq, wk, newStatus, hash);
+					if constexpr (BoardPiece::Bishop == piece)  next = Board(bp & rem, bn & rem, bb & rem, br & rem, bq & rem, bk, wp, wn, wb ^ mov, wr, wq, wk, newStatus, hash);
+					if constexpr (BoardPiece::Rook == piece)    next = Board(bp & rem, bn & rem, bb & rem, br & rem, bq & rem, bk, wp, wn, wb, wr ^ mov, wq, wk, newStatus, hash);
+					if constexpr (BoardPiece::Queen == piece)   next = Board(bp & rem, bn & rem, bb & rem, br & rem, bq & rem, bk, wp, wn, wb, wr, wq ^ mov, wk, newStatus, hash);
+					if constexpr (BoardPiece::King == piece)    next = Board(bp & rem, bn & rem, bb & rem, br & rem, bq & rem, bk, wp, wn, wb, wr, wq, wk ^ mov, newStatus, hash);
 				}
 				else {
 					assert((wk & mov) == 0 && "Taking White King is not legal!");
 					assert((to & existing.Black()) == 0 && "Cannot move to square of same black color!");
-					if constexpr (BoardPiece::Pawn == piece)    return Board(bp ^ mov, bn, bb, br, bq, bk, wp & rem, wn & rem, wb & rem, wr & rem, wq & rem, wk, newStatus);
-					if constexpr (BoardPiece::Knight == piece)  return Board(bp, bn ^ mov, bb, br, bq, bk, wp & rem, wn & rem, wb & rem, wr & rem, wq & rem, wk, newStatus);
-					if constexpr (BoardPiece::Bishop == piece)  return Board(bp, bn, bb ^ mov, br, bq, bk, wp & rem, wn & rem, wb & rem, wr & rem, wq & rem, wk, newStatus);
-					if constexpr (BoardPiece::Rook == piece)    return Board(bp, bn, bb, br ^ mov, bq, bk, wp & rem, wn & rem, wb & rem, wr & rem, wq & rem, wk, newStatus);
-					if constexpr (BoardPiece::Queen == piece)   return Board(bp, bn, bb, br, bq ^ mov, bk, wp & rem, wn & rem, wb & rem, wr & rem, wq & rem, wk, newStatus);
-					if constexpr (BoardPiece::King == piece)    return Board(bp, bn, bb, br, bq, bk ^ mov, wp & rem, wn & rem, wb & rem, wr & rem, wq & rem, wk, newStatus);
+					if constexpr (BoardPiece::Pawn == piece)    next = Board(bp ^ mov, bn, bb, br, bq, bk, wp & rem, wn & rem, wb & rem, wr & rem, wq & rem, wk, newStatus, hash);
+					if constexpr (BoardPiece::Knight == piece)  next = Board(bp, bn ^ mov, bb, br, bq, bk, wp & rem, wn & rem, wb & rem, wr & rem, wq & rem, wk, newStatus, hash);
+					if constexpr (BoardPiece::Bishop == piece)  next = Board(bp, bn, bb ^ mov, br, bq, bk, wp & rem, wn & rem, wb & rem, wr & rem, wq & rem, wk, newStatus, hash);
+					if constexpr (BoardPiece::Rook == piece)    next = Board(bp, bn, bb, br ^ mov, bq, bk, wp & rem, wn & rem, wb & rem, wr & rem, wq & rem, wk, newStatus, hash);
+					if constexpr (BoardPiece::Queen == piece)   next = Board(bp, bn, bb, br, bq ^ mov, bk, wp & rem, wn & rem, wb & rem, wr & rem, wq & rem, wk, newStatus, hash);
+					if constexpr (BoardPiece::King == piece)    next = Board(bp, bn, bb, br, bq, bk ^ mov, wp & rem, wn & rem, wb & rem, wr & rem, wq & rem, wk, newStatus, hash);
 				}
 			}
 			else {
 				if constexpr (IsWhite) {
 					assert((bk & mov) == 0 && "Taking Black King is not legal!");
 					assert((to & existing.White()) == 0 && "Cannot move to square of same white color!");
-					if constexpr (BoardPiece::Pawn == piece)    return Board(bp, bn, bb, br, bq, bk, wp ^ mov, wn, wb, wr, wq, wk, newStatus);
-					if constexpr (BoardPiece::Knight == piece)  return Board(bp, bn, bb, br, bq, bk, wp, wn ^ mov, wb, wr, wq, wk, newStatus);
-					if constexpr (BoardPiece::Bishop == piece)  return Board(bp, bn, bb, br, bq, bk, wp, wn, wb ^ mov, wr, wq, wk, newStatus);
-					if constexpr (BoardPiece::Rook == piece)    return Board(bp, bn, bb, br, bq, bk, wp, wn, wb, wr ^ mov, wq, wk, newStatus);
-					if constexpr (BoardPiece::Queen == piece)   return Board(bp, bn, bb, br, bq, bk, wp, wn, wb, wr, wq ^ mov, wk, newStatus);
-					if constexpr (BoardPiece::King == piece)    return Board(bp, bn, bb, br, bq, bk, wp, wn, wb, wr, wq, wk ^ mov, newStatus);
+					if constexpr (BoardPiece::Pawn == piece)    next = Board(bp, bn, bb, br, bq, bk, wp ^ mov, wn, wb, wr, wq, wk, newStatus, hash);
+					if constexpr (BoardPiece::Knight == piece)  next = Board(bp, bn, bb, br, bq, bk, wp, wn ^ mov, wb, wr, wq, wk, newStatus, hash);
+					if constexpr (BoardPiece::Bishop == piece)  next = Board(bp, bn, bb, br, bq, bk, wp, wn, wb ^ mov, wr, wq, wk, newStatus, hash);
+					if constexpr (BoardPiece::Rook == piece)    next = Board(bp, bn, bb, br, bq, bk, wp, wn, wb, wr ^ mov, wq, wk, newStatus, hash);
+					if constexpr (BoardPiece::Queen == piece)   next = Board(bp, bn, bb, br, bq, bk, wp, wn, wb, wr, wq ^ mov, wk, newStatus, hash);
+					if constexpr (BoardPiece::King == piece)    next = Board(bp, bn, bb, br, bq, bk, wp, wn, wb, wr, wq, wk ^ mov, newStatus, hash);
 				}
 				else {
 					assert((wk & mov) == 0 && "Taking White King is not legal!");
 					assert((to & existing.Black()) == 0 && "Cannot move to square of same black color!");
-					if constexpr (BoardPiece::Pawn == piece)    return Board(bp ^ mov, bn, bb, br, bq, bk, wp, wn, wb, wr, wq, wk, newStatus);
-					if constexpr (BoardPiece::Knight == piece)  return Board(bp, bn ^ mov, bb, br, bq, bk, wp, wn, wb, wr, wq, wk, newStatus);
-					if constexpr (BoardPiece::Bishop == piece)  return Board(bp, bn, bb ^ mov, br, bq, bk, wp, wn, wb, wr, wq, wk, newStatus);
-					if constexpr (BoardPiece::Rook == piece)    return Board(bp, bn, bb, br ^ mov, bq, bk, wp, wn, wb, wr, wq, wk, newStatus);
-					if constexpr (BoardPiece::Queen == piece)   return Board(bp, bn, bb, br, bq ^ mov, bk, wp, wn, wb, wr, wq, wk, newStatus);
-					if constexpr (BoardPiece::King == piece)    return Board(bp, bn, bb, br, bq, bk ^ mov, wp, wn, wb, wr, wq, wk, newStatus);
+					if constexpr (BoardPiece::Pawn == piece)    next = Board(bp ^ mov, bn, bb, br, bq, bk, wp, wn, wb, wr, wq, wk, newStatus, hash);
+					if constexpr (BoardPiece::Knight == piece)  next = Board(bp, bn ^ mov, bb, br, bq, bk, wp, wn, wb, wr, wq, wk, newStatus, hash);
+					if constexpr (BoardPiece::Bishop == piece)  next = Board(bp, bn, bb ^ mov, br, bq, bk, wp, wn, wb, wr, wq, wk, newStatus, hash);
+					if constexpr (BoardPiece::Rook == piece)    next = Board(bp, bn, bb, br ^ mov, bq, bk, wp, wn, wb, wr, wq, wk, newStatus, hash);
+					if constexpr (BoardPiece::Queen == piece)   next = Board(bp, bn, bb, br, bq ^ mov, bk, wp, wn, wb, wr, wq, wk, newStatus, hash);
+					if constexpr (BoardPiece::King == piece)    next = Board(bp, bn, bb, br, bq, bk ^ mov, wp, wn, wb, wr, wq, wk, newStatus, hash);
 				}
 			}
+
+#ifdef MAILBOX_SUPPORT
+			if constexpr (UpdateHash) {
+				next.Mailbox = existing.Mailbox;
+				next.Mailbox[SquareOf(from)] = MailboxEmpty;
+				next.Mailbox[SquareOf(to)] = MailboxCode<piece, IsWhite>();
+			}
+#endif
+			return next;
 		}
 
 		Board SkipMove() const {
-			return Board(BPawn, BKnight, BBishop, BRook, BQueen, BKing, WPawn, WKnight, WBishop, WRook, WQueen, WKing, status.SilentMove());
+			Board next(BPawn, BKnight, BBishop, BRook, BQueen, BKing, WPawn, WKnight, WBishop, WRook, WQueen, WKing, status.SilentMove(), Hash ^ StatusKey(*this, status.SilentMove()));
+#ifdef MAILBOX_SUPPORT
+			next.Mailbox = Mailbox;
+#endif
+			return next;
+		}
+
+		static FenPosition ParseFen(std::string_view fen) {
+			FenPosition pos;
+			[[maybe_unused]] const FenError error = FEN::Parse(fen, pos);
+			assert(error == FenError::None);
+			return pos;
 		}
 
 		static std::string StartPositionFen() {
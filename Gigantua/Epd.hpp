@@ -0,0 +1,133 @@
+#pragma once
+
+#include <string_view>
+#include <array>
+#include <cstring>
+#include <algorithm>
+#include "ChessBase.hpp"
+#include "MappedFile.hpp"
+
+namespace Gigantua {
+namespace EPD {
+
+	//One line of an EPD file: a FEN without or with move counters followed by 'opcode operand;' operations.
+	//The ChessTest.hpp style ';D1 20 ;D2 400' is accepted as well. Views point into the parsed text
+	struct Record {
+		std::string_view line;
+		FenPosition position;
+		FenError error = FenError::None;
+		std::string_view bm;
+		std::string_view am;
+		std::string_view id;
+		std::array<uint64_t, 10> perft{}; //perft[d] from the Dd opcode, 0 when missing
+		uint8_t perftDepth = 0;           //Deepest Dd present
+
+		Board board() const { return Board(position); }
+	};
+
+	static constexpr std::string_view Trim(std::string_view str) {
+		while (!str.empty() && (str.front() == ' ' || str.front() == '\t')) str.remove_prefix(1);
+		while (!str.empty() && (str.back() == ' ' || str.back() == '\t' || str.back() == '\r')) str.remove_suffix(1);
+		return str;
+	}
+
+	static constexpr uint64_t ParseCount(std::string_view str) {
+		uint64_t value = 0;
+		for (char c : str) {
+			if (c < '0' || c > '9') break;
+			value = value * 10 + (c - '0');
+		}
+		return value;
+	}
+
+	//Parses one line. Unknown opcodes are skipped
+	static FenError ParseLine(std::string_view line, Record& rec)
+	{
+		rec.line = line;
+		rec.bm = rec.am = rec.id = {};
+		rec.perft.fill(0);
+		rec.perftDepth = 0;
+
+		rec.error = FEN::Parse(line, rec.position);
+		if (rec.error != FenError::None) return rec.error;
+
+		size_t i = rec.position.length;
+		const size_t n = line.size();
+		while (i < n) {
+			while (i < n && (line[i] == ' ' || line[i] == '\t' || line[i] == ';')) i++;
+			const size_t opStart = i;
+			while (i < n && line[i] != ' ' && line[i] != '\t' && line[i] != ';') i++;
+			const std::string_view opcode = line.substr(opStart, i - opStart);
+
+			//Operand runs to the next ';' outside of quotes
+			const size_t argStart = i;
+			for (bool quoted = false; i < n && (quoted || line[i] != ';'); i++)
+				quoted ^= line[i] == '"';
+
+			std::string_view operand = Trim(line.substr(argStart, i - argStart));
+			if (operand.size() >= 2 && operand.front() == '"' && operand.back() == '"') operand = operand.substr(1, operand.size() - 2);
+
+			if (opcode.size() == 2) {
+				if (opcode[0] == 'D' && opcode[1] >= '1' && opcode[1] <= '9') {
+					const uint8_t depth = uint8_t(opcode[1] - '0');
+					rec.perft[depth] = ParseCount(operand);
+					rec.perftDepth = std::max(rec.perftDepth, depth);
+				}
+				else if (opcode == "bm") rec.bm = operand;
+				else if (opcode == "am") rec.am = operand;
+				else if (opcode == "id") rec.id = operand;
+			}
+			else if (opcode == "hmvc") rec.position.halfMove = uint16_t(ParseCount(operand));
+			else if (opcode == "fmvn") rec.position.fullMove = uint16_t(ParseCount(operand));
+		}
+		return FenError::None;
+	}
+
+	//Streams records out of a read-only memory mapped file. Lines are found with memchr and parsed in place - nothing is copied
+	class Reader {
+	private:
+		MappedFile m_file;
+		const char* m_data;
+		size_t m_size;
+		size_t m_pos = 0;
+		size_t m_line = 0;
+
+	public:
+		explicit Reader(const char* path) : m_file(path, MappedFile::Access::Sequential),
+			m_data((const char*)m_file.Data()), m_size(m_file.Size()) {
+		}
+
+		bool IsOpen() const { return m_file.IsOpen(); }
+		size_t Size() const { return m_size; }
+
+		//1 based line of the record returned by the last Next
+		size_t Line() const { return m_line; }
+
+		//Next non empty line. Returns false at the end of the file. A line with a bad FEN is returned with rec.error set
+		bool Next(Record& rec)
+		{
+			while (m_pos < m_size) {
+				const char* start = m_data + m_pos;
+				const char* end = (const char*)std::memchr(start, '\n', m_size - m_pos);
+				if (!end) end = m_data + m_size;
+
+				m_pos = size_t(end - m_data) + 1;
+				m_line++;
+
+				const std::string_view line = Trim(std::string_view(start, size_t(end - start)));
+				if (line.empty() || line.front() == '#') continue;
+
+				ParseLine(line, rec);
+				return true;
+			}
+			return false;
+		}
+
+		void Rewind() {
+			m_pos = 0;
+			m_line = 0;
+		}
+	};
+
+}
+}
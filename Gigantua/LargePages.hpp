@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <new>
+#include <fstream>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+//Page aligned zeroed blocks for the big tables: TT, game tree and the owned network weights. Random probes into
+//hundreds of MB miss the TLB on almost every access with 4KB pages, 2MB pages cover them with a few hundred entries.
+//Tried in order: explicit huge pages (MAP_HUGETLB, needs vm.nr_hugepages reserved), transparent huge pages
+//requested with madvise, plain pages. Windows always gets plain pages - large pages there need the lock memory
+//privilege granted to the account, which an engine cannot count on
+namespace LargePages {
+
+	enum class Kind : uint8_t {
+		Normal, Transparent, Huge
+	};
+
+	static constexpr size_t HugePageSize = 2 * 1024 * 1024;
+
+	static constexpr const char* KindStr(Kind kind) {
+		switch (kind) {
+		case Kind::Normal: return "4KB pages";
+		case Kind::Transparent: return "2MB transparent huge pages";
+		case Kind::Huge: return "2MB huge pages";
+		}
+		return "unknown";
+	}
+
+	namespace detail {
+		//Smallest kind any block of at least HugePageSize got, 0xFF before the first one
+		inline std::atomic<uint8_t> obtained = 0xFF;
+
+		inline void Record(Kind kind, size_t bytes) {
+			if (bytes < HugePageSize) return;
+			uint8_t current = obtained;
+			while (uint8_t(kind) < current && !obtained.compare_exchange_weak(current, uint8_t(kind)));
+		}
+
+		//Blocks worth a huge page are rounded to whole huge pages, so Free can recompute the mapped size
+		inline size_t Rounded(size_t bytes) {
+			const size_t page = bytes >= HugePageSize ? HugePageSize : 4096;
+			return (bytes + page - 1) & ~(page - 1);
+		}
+
+#if !defined(_WIN32) && defined(MADV_HUGEPAGE)
+		//madvise succeeds even when the kernel never hands out transparent huge pages
+		inline bool TransparentEnabled() {
+			std::ifstream file("/sys/kernel/mm/transparent_hugepage/enabled");
+			std::string mode;
+			std::getline(file, mode);
+			return !mode.empty() && mode.find("[never]") == std::string::npos;
+		}
+#endif
+	}
+
+	//nullptr when out of memory
+	inline void* Alloc(size_t bytes, Kind& kind) {
+		kind = Kind::Normal;
+		const size_t size = detail::Rounded(bytes);
+		void* result = nullptr;
+
+#ifdef _WIN32
+		result = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+		if (size >= HugePageSize) {
+#ifdef MAP_HUGETLB
+			result = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+			if (result == MAP_FAILED) result = nullptr;
+			else kind = Kind::Huge;
+#endif
+			if (!result) {
+				//Over map and trim to a 2MB boundary, otherwise the ends of the range stay on small pages
+				void* raw = mmap(nullptr, size + HugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+				if (raw == MAP_FAILED) return nullptr;
+				const uintptr_t start = (uintptr_t(raw) + HugePageSize - 1) & ~uintptr_t(HugePageSize - 1);
+				const size_t head = size_t(start - uintptr_t(raw));
+				if (head) munmap(raw, head);
+				if (HugePageSize - head) munmap((void*)(start + size), HugePageSize - head);
+				result = (void*)start;
+#ifdef MADV_HUGEPAGE
+				if (madvise(result, size, MADV_HUGEPAGE) == 0 && detail::TransparentEnabled()) kind = Kind::Transparent;
+#endif
+			}
+		}
+		else {
+			result = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (result == MAP_FAILED) return nullptr;
+		}
+#endif
+
+		if (result) detail::Record(kind, bytes);
+		return result;
+	}
+
+	//bytes as passed to Alloc
+	inline void Free(void* ptr, size_t bytes) {
+		if (!ptr) return;
+#ifdef _WIN32
+		(void)bytes;
+		VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+		munmap(ptr, detail::Rounded(bytes));
+#endif
+	}
+
+	//Worst page size any table of 2MB or more got - for the startup log
+	inline Kind Obtained() {
+		const uint8_t kind = detail::obtained;
+		return kind == 0xFF ? Kind::Normal : Kind(kind);
+	}
+
+	//For std::vector backed tables
+	template<typename T>
+	struct Allocator {
+		using value_type = T;
+
+		Allocator() = default;
+		template<typename U> Allocator(const Allocator<U>&) {}
+
+		T* allocate(size_t n) {
+			Kind kind;
+			void* result = Alloc(n * sizeof(T), kind);
+			if (!result) throw std::bad_alloc();
+			return (T*)result;
+		}
+
+		void deallocate(T* ptr, size_t n) {
+			Free(ptr, n * sizeof(T));
+		}
+
+		template<typename U> bool operator==(const Allocator<U>&) const { return true; }
+		template<typename U> bool operator!=(const Allocator<U>&) const { return false; }
+	};
+}
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <assert.h>
+#include "MoveMap.hpp"
+
+//Fancy magic bitboards for the sliders - the same answers as ChessLookup::LookupBmi2 without pext.
+//The fallback on cpus without bmi2 and on AMD before Zen 3 where pext is microcoded. Tables are filled once at startup
+namespace ChessLookup {
+namespace LookupMagic {
+
+	namespace detail {
+		struct Magic {
+			const uint64_t* attacks;
+			uint64_t mask;
+			uint64_t magic;
+			uint32_t shift;
+
+			_ForceInline uint32_t index(uint64_t occ) const {
+				return uint32_t(((occ & mask) * magic) >> shift);
+			}
+		};
+
+		static constexpr int RookDirs[4][2] = { {1, 0}, {-1, 0}, {0, 1}, {0, -1} };
+		static constexpr int BishopDirs[4][2] = { {1, 1}, {-1, 1}, {1, -1}, {-1, -1} };
+
+		//Attacks by walking the rays. edges = false leaves out the last square of every ray (relevant occupancy mask)
+		static uint64_t Walk(int sq, const int (&dirs)[4][2], uint64_t occ, bool edges)
+		{
+			uint64_t result = 0;
+			for (const auto& d : dirs) {
+				int file = sq % 8 + d[0], rank = sq / 8 + d[1];
+				for (; file >= 0 && file < 8 && rank >= 0 && rank < 8; file += d[0], rank += d[1]) {
+					const int nf = file + d[0], nr = rank + d[1];
+					if (!edges && (nf < 0 || nf > 7 || nr < 0 || nr > 7)) break;
+					const uint64_t bit = 1ull << (file + rank * 8);
+					result |= bit;
+					if (occ & bit) break;
+				}
+			}
+			return result;
+		}
+
+		//Found offline with the usual sparse random search for this square numbering (bit 0 = h1)
+		static constexpr std::array<uint64_t, 64> RookMagics = {
+			0x0A80004000801220ull, 0x8040004010002008ull, 0x2080200010008008ull, 0x1100100008210004ull,
+			0xC200209084020008ull, 0x2100010004000208ull, 0x0400081000822421ull, 0x0200010422048844ull,
+			0x0041800280400020ull, 0x0001404010002000ull, 0x2083004020010010ull, 0x0000801000800804ull,
+			0x1130808008000400ull, 0x0021000900020400ull, 0x4002808011000200ull, 0x0802000102088464ull,
+			0x0040828004400020ull, 0x4010084020004000ull, 0x0420004010004801ull, 0xA020808008001000ull,
+			0x5000808008000400ull, 0x0004280110402460ull, 0x8180040030018208ull, 0x0800020000440081ull,
+			0x4200400280048021ull, 0x6000208100400100ull, 0x2000104100200100ull, 0x1208100080080084ull,
+			0x0412000A00200410ull, 0x8400020080800400ull, 0x8684900400210228ull, 0x0210004200010084ull,
+			0x8200400082800020ull, 0x8240200080804000ull, 0x0120001001802084ull, 0x0010021101000920ull,
+			0x0000800400800802ull, 0x200C000200800480ull, 0x2400100104000248ull, 0x0010800040800100ull,
+			0x0001800040038021ull, 0x2401201002444000ull, 0x8548200100110040ull, 0x0110040008004040ull,
+			0x00A1000800050010ull, 0x2801008400090002ull, 0x0B28880201040050ull, 0x2004008410420001ull,
+			0x2102042084410200ull, 0x2080201000400240ull, 0x0001001020004100ull, 0x0200081000210100ull,
+			0x0008080080040080ull, 0x0A02010408100200ull, 0x1040800200010080ull, 0x008C004899040200ull,
+			0x0020850200244012ull, 0x0020850200244012ull, 0x0000102001040841ull, 0x140900040A100021ull,
+			0x000200282410A102ull, 0x000200282410A102ull, 0x000200282410A102ull, 0x4048240043802106ull
+		};
+
+		static constexpr std::array<uint64_t, 64> BishopMagics = {
+			0x40106000A1160020ull, 0x0020010250810120ull, 0x2010010220280081ull, 0x002806004050C040ull,
+			0x0002021018000000ull, 0x2001112010000400ull, 0x0881010120218080ull, 0x1030820110010500ull,
+			0xA000411101010100ull, 0x9000200104608880ull, 0x000C1000BA004888ull, 0x0090244400850485ull,
+			0x0200040504128140ull, 0x308D010402400000ull, 0x3000010092104040ull, 0x0204002101101084ull,
+			0x4204004008424420ull, 0x5184002088088305ull, 0xE008401000920010ull, 0x89030D7024008000ull,
+			0x0011020820080405ull, 0x0000208200900810ull, 0x0880400884500800ull, 0x6236201A12050404ull,
+			0x0804200010608100ull, 0xC281904120020200ull, 0x109428020C080021ull, 0x0040040042430020ull,
+			0x2418840009802000ull, 0x00B0204002080200ull, 0x50A8006A0A022200ull, 0x1011020011462080ull,
+			0x1050080924041000ull, 0x005484A40A103000ull, 0x4009441200100024ull, 0x2000020080080080ull,
+			0x0108020401001100ull, 0x10100408204D1005ull, 0x0A020204008200C0ull, 0x2000820044408400ull,
+			0x0009411040081000ull, 0x1019009004001000ull, 0x8440210040483800ull, 0x4000084010400208ull,
+			0x1030142704002A10ull, 0x4190B01000200041ull, 0x24108450A4045380ull, 0x2108008104500202ull,
+			0x0400841008040300ull, 0x0000208410080100ull, 0x681001008804000Aull, 0x042080C042120508ull,
+			0x8018004005010005ull, 0x2102042084410200ull, 0x8052200204104828ull, 0x4082103202004006ull,
+			0x0001008044200440ull, 0x0004C04410841000ull, 0x2000500104011130ull, 0x1A0C010011C20229ull,
+			0x0044800112202200ull, 0x0434804908100424ull, 0x0300404822C08200ull, 0x48081010008A2A80ull
+		};
+
+		template<size_t TableSize>
+		struct Slider {
+			std::array<Magic, 64> magics;
+			std::array<uint64_t, TableSize> table;
+
+			Slider(const int (&dirs)[4][2], const std::array<uint64_t, 64>& magicNumbers)
+			{
+				size_t offset = 0;
+				for (int sq = 0; sq < 64; sq++) {
+					Magic& m = magics[sq];
+					m.mask = Walk(sq, dirs, 0, false);
+					m.magic = magicNumbers[sq];
+					m.shift = 64 - uint32_t(Bitcount(m.mask));
+					m.attacks = table.data() + offset;
+
+					//Carry rippler over all subsets of the mask. Colliding subsets share the attack set
+					uint64_t occ = 0;
+					do {
+						table[offset + m.index(occ)] = Walk(sq, dirs, occ, true);
+						occ = (occ - m.mask) & m.mask;
+					} while (occ);
+					offset += size_t(1) << (64 - m.shift);
+				}
+				assert(offset == TableSize);
+			}
+		};
+
+		inline const Slider<0x19000> Rooks(RookDirs, RookMagics);
+		inline const Slider<0x1480> Bishops(BishopDirs, BishopMagics);
+
+		//Single step attacks, no occupancy
+		template<size_t N>
+		static constexpr std::array<uint64_t, 64> Steps(const int (&steps)[N][2])
+		{
+			std::array<uint64_t, 64> result{};
+			for (int sq = 0; sq < 64; sq++) {
+				for (const auto& s : steps) {
+					const int file = sq % 8 + s[0], rank = sq / 8 + s[1];
+					if (file >= 0 && file < 8 && rank >= 0 && rank < 8) result[sq] |= 1ull << (file + rank * 8);
+				}
+			}
+			return result;
+		}
+
+		static constexpr int KnightSteps[8][2] = { {1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2} };
+		static constexpr int KingSteps[8][2] = { {1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}, {0, -1}, {1, -1} };
+		inline constexpr std::array<uint64_t, 64> Knights = Steps(KnightSteps);
+		inline constexpr std::array<uint64_t, 64> Kings = Steps(KingSteps);
+	}
+
+	//Knight and king are plain tables, the pext backend uses them too
+	_ForceInline uint64_t Knight(int sq) {
+		return detail::Knights[sq];
+	}
+
+	_ForceInline uint64_t King(int sq) {
+		return detail::Kings[sq];
+	}
+
+	_ForceInline uint64_t Rook(int sq, uint64_t occ) {
+		const detail::Magic& m = detail::Rooks.magics[sq];
+		return m.attacks[m.index(occ)];
+	}
+
+	_ForceInline uint64_t Bishop(int sq, uint64_t occ) {
+		const detail::Magic& m = detail::Bishops.magics[sq];
+		return m.attacks[m.index(occ)];
+	}
+
+	_ForceInline uint64_t Queen(int sq, uint64_t occ) {
+		return Rook(sq, occ) | Bishop(sq, occ);
+	}
+
+	//Squares that become visible once the first blockers are removed
+	_ForceInline uint64_t Rook_Xray(int sq, uint64_t occ) {
+		const uint64_t atk = Rook(sq, occ);
+		return atk ^ Rook(sq, occ ^ (occ & atk));
+	}
+
+	_ForceInline uint64_t Bishop_Xray(int sq, uint64_t occ) {
+		const uint64_t atk = Bishop(sq, occ);
+		return atk ^ Bishop(sq, occ ^ (occ & atk));
+	}
+}
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace Gigantua {
+
+	//Read only view of a whole file, shared with the page cache. Not open for missing or empty files.
+	//Sequential for files streamed once front to back (EPD), Random for data looked up all over (network weights)
+	class MappedFile {
+	public:
+		enum class Access : uint8_t { Sequential, Random };
+
+	private:
+		const uint8_t* m_data = nullptr;
+		size_t m_size = 0;
+#ifdef _WIN32
+		HANDLE m_file = INVALID_HANDLE_VALUE;
+		HANDLE m_mapping = nullptr;
+#endif
+
+	public:
+		explicit MappedFile(const char* path, Access access = Access::Random)
+		{
+#ifdef _WIN32
+			const DWORD flags = access == Access::Sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_ATTRIBUTE_NORMAL;
+			m_file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, flags, nullptr);
+			if (m_file == INVALID_HANDLE_VALUE) return;
+			LARGE_INTEGER size;
+			if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0) return;
+			m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (!m_mapping) return;
+			m_data = (const uint8_t*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+			if (m_data) m_size = size_t(size.QuadPart);
+#else
+			const int fd = open(path, O_RDONLY);
+			if (fd < 0) return;
+			struct stat st;
+			if (fstat(fd, &st) == 0 && st.st_size > 0) {
+				void* data = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+				if (data != MAP_FAILED) {
+					madvise(data, size_t(st.st_size), access == Access::Sequential ? MADV_SEQUENTIAL : MADV_WILLNEED);
+					m_data = (const uint8_t*)data;
+					m_size = size_t(st.st_size);
+				}
+			}
+			close(fd);
+#endif
+		}
+
+		~MappedFile()
+		{
+#ifdef _WIN32
+			if (m_data) UnmapViewOfFile(m_data);
+			if (m_mapping) CloseHandle(m_mapping);
+			if (m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+#else
+			if (m_data) munmap((void*)m_data, m_size);
+#endif
+		}
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		bool IsOpen() const { return m_data != nullptr; }
+		const uint8_t* Data() const { return m_data; }
+		size_t Size() const { return m_size; }
+	};
+}
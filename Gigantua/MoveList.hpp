@@ -7,6 +7,9 @@ namespace Gigantua{
 
 	namespace MoveList {
 
+		//Which moves _enumerate emits. Captures includes enpassant and all promotions, Quiets is everything else
+		enum class GenMode { All, Captures, Quiets };
+
 		template<class TImpl, bool white>
 		class MoveCollectorBase
 		{
@@ -84,15 +87,44 @@ namespace Gigantua{
 			}
 		};
 
+		//Fixed capacity move list that lives on the stack - no legal position has more than 218 moves
 		template<bool white>
-		class MoveCollector : public Gigantua::MoveList::MoveCollectorBase<MoveCollector<white>, white>
+		class MoveArray
 		{
 		public:
-			mutable std::vector<Board::Move<white>> moves;
-			MoveCollector() {
-				moves.reserve(128);
+			static constexpr size_t Capacity = 256;
+
+		private:
+			std::array<Board::Move<white>, Capacity> m_moves;
+			uint16_t m_size = 0;
+
+		public:
+			_ForceInline void push_back(const Board::Move<white>& move)
+			{
+				assert(m_size < Capacity);
+				m_moves[m_size++] = move;
 			}
 
+			void clear() { m_size = 0; }
+			size_t size() const { return m_size; }
+			bool empty() const { return m_size == 0; }
+
+			const Board::Move<white>& operator[](size_t i) const { return m_moves[i]; }
+			Board::Move<white>& operator[](size_t i) { return m_moves[i]; }
+
+			const Board::Move<white>* begin() const { return m_moves.data(); }
+			const Board::Move<white>* end() const { return m_moves.data() + m_size; }
+			Board::Move<white>* begin() { return m_moves.data(); }
+			Board::Move<white>* end() { return m_moves.data() + m_size; }
+		};
+
+		template<bool white>
+		class MoveCollector : public Gigantua::MoveList::MoveCollectorBase<MoveCollector<white>, white>
+		{
+		public:
+			MoveArray<white>& moves;
+			MoveCollector(MoveArray<white>& moves) : moves(moves) {}
+
 			void CollectImpl(const Board::Move<white>& move) const
 			{
 				moves.push_back(move);
@@ -111,6 +143,20 @@ namespace Gigantua{
 			}
 		};
 
+		template<bool white>
+		class MoveFinder : public Gigantua::MoveList::MoveCollectorBase<MoveFinder<white>, white>
+		{
+		public:
+			const uint16_t move;
+			mutable bool found = false;
+			MoveFinder(uint16_t move) : move(move) {}
+
+			void CollectImpl(const Board::Move<white>& candidate) const
+			{
+				found |= candidate.move == move;
+			}
+		};
+
 		//PinHVD1D2 |= Path from Enemy to excluding King + enemy. Has Seemap from king as input
 		//Must have enemy slider AND own piece or - VERY special: can clear enemy enpassant pawn
 		template<bool white>
@@ -150,7 +196,7 @@ namespace Gigantua{
 			else return 0xFFull << 24;
 		}
 
-		template<bool white>
+		template<bool white, class TLookup>
 		_ForceInline void RegisterPinEP(uint8_t kingsquare, uint64_t king, uint64_t enemyRQ, const Board& brd, uint64_t& epTarget)
 		{
 			const uint64_t pawns = Pawns<white>(brd);
@@ -168,11 +214,11 @@ namespace Gigantua{
 
 				if (EPLpawn) {
 					uint64_t AfterEPocc = brd.Occ() & ~(epTarget | EPLpawn);
-					if ((Lookup::Rook(kingsquare, AfterEPocc) & EPRank<white>()) & enemyRQ) epTarget = 0;
+					if ((TLookup::Rook(kingsquare, AfterEPocc) & EPRank<white>()) & enemyRQ) epTarget = 0;
 				}
 				if (EPRpawn) {
 					uint64_t AfterEPocc = brd.Occ() & ~(epTarget | EPRpawn);
-					if ((Lookup::Rook(kingsquare, AfterEPocc) & EPRank<white>()) & enemyRQ) epTarget = 0;
+					if ((TLookup::Rook(kingsquare, AfterEPocc) & EPRank<white>()) & enemyRQ) epTarget = 0;
 				}
 			}
 		}
@@ -188,7 +234,7 @@ namespace Gigantua{
 		}
 
 
-		template<bool white>
+		template<bool white, class TLookup>
 		_ForceInline uint64_t Refresh(const Board& brd, uint64_t& kingban, uint64_t& checkmask, uint64_t& epTarget, uint64_t& rookPin, uint64_t& bishopPin)
 		{
 			constexpr bool enemy = !white;
@@ -204,24 +250,24 @@ namespace Gigantua{
 
 				if (ChessLookup::RookMask[kingsq] & EnemyRookQueen<white>(brd))
 				{
-					uint64_t atkHV = Lookup::Rook(kingsq, brdOcc) & EnemyRookQueen<white>(brd);
+					uint64_t atkHV = TLookup::Rook(kingsq, brdOcc) & EnemyRookQueen<white>(brd);
 					Bitloop(atkHV) {
 						CheckBySlider(kingsq, SquareOf(atkHV), kingban, checkmask);
 					}
 
-					uint64_t pinnersHV = Lookup::Rook_Xray(kingsq, brdOcc) & EnemyRookQueen<white>(brd);
+					uint64_t pinnersHV = TLookup::Rook_Xray(kingsq, brdOcc) & EnemyRookQueen<white>(brd);
 					Bitloop(pinnersHV)
 					{
 						RegisterPinHV<white>(kingsq, SquareOf(pinnersHV), brd, rookPin);
 					}
 				}
 				if (ChessLookup::BishopMask[kingsq] & EnemyBishopQueen<white>(brd)) {
-					uint64_t atkD12 = Lookup::Bishop(kingsq, brdOcc) & EnemyBishopQueen<white>(brd);
+					uint64_t atkD12 = TLookup::Bishop(kingsq, brdOcc) & EnemyBishopQueen<white>(brd);
 					Bitloop(atkD12) {
 						CheckBySlider(kingsq, SquareOf(atkD12), kingban, checkmask);
 					}
 
-					uint64_t pinnersD12 = Lookup::Bishop_Xray(kingsq, brdOcc) & EnemyBishopQueen<white>(brd);
+					uint64_t pinnersD12 = TLookup::Bishop_Xray(kingsq, brdOcc) & EnemyBishopQueen<white>(brd);
 					Bitloop(pinnersD12)
 					{
 						RegisterPinD12<white>(kingsq, SquareOf(pinnersD12), brd, epTarget, bishopPin);
@@ -230,18 +276,18 @@ namespace Gigantua{
 
 				if (epTarget)
 				{
-					RegisterPinEP<white>(kingsq, king, EnemyRookQueen<white>(brd), brd, epTarget);
+					RegisterPinEP<white, TLookup>(kingsq, king, EnemyRookQueen<white>(brd), brd, epTarget);
 				}
 			}
 
-			uint64_t king_atk = Lookup::King(kingsq) & EnemyOrEmpty<white>(brd) & ~kingban;
+			uint64_t king_atk = TLookup::King(kingsq) & EnemyOrEmpty<white>(brd) & ~kingban;
 			if (king_atk == 0) return 0;
 
 			//Calculate Enemy Knight - keep this first
 			{
 				uint64_t knights = Knights<enemy>(brd);
 				Bitloop(knights) {
-					kingban |= Lookup::Knight(SquareOf(knights));
+					kingban |= TLookup::Knight(SquareOf(knights));
 				}
 			}
 
@@ -253,7 +299,7 @@ namespace Gigantua{
 			{
 				uint64_t bishops = BishopQueen<enemy>(brd);
 				Bitloop(bishops) {
-					kingban |= Lookup::Bishop(SquareOf(bishops), brdOcc);
+					kingban |= TLookup::Bishop(SquareOf(bishops), brdOcc);
 				}
 			}
 
@@ -261,7 +307,7 @@ namespace Gigantua{
 			{
 				uint64_t rooks = RookQueen<enemy>(brd);
 				Bitloop(rooks) {
-					kingban |= Lookup::Rook(SquareOf(rooks), brdOcc);
+					kingban |= TLookup::Rook(SquareOf(rooks), brdOcc);
 				}
 			}
 
@@ -328,32 +374,48 @@ namespace Gigantua{
 			pawn = (pinned | unpinned); //You can go forward and you and your targetsquare is allowed
 		}
 
-		template<class TCollectImpl, bool white>
+		template<GenMode mode, bool white>
+		_Compiletime uint64_t TargetSquares(const Board& brd)
+		{
+			if constexpr (mode == GenMode::Captures) return Enemy<white>(brd);
+			else if constexpr (mode == GenMode::Quiets) return Empty(brd);
+			else return EnemyOrEmpty<white>(brd);
+		}
+
+		//HasEP, CastleL and CastleR are the status of the side to move. Setting all three gives the generic version that tests everything at runtime
+		template<class TCollectImpl, bool white, GenMode mode, bool HasEP, bool CastleL, bool CastleR, class TLookup>
 		_ForceInline void _enumerate(
 			const Board& brd, uint64_t kingatk, const uint64_t kingban, const uint64_t checkmask, const uint64_t epTarget, const uint64_t rookPin, const uint64_t bishopPin, TCollectImpl& collector)
 		{
+			constexpr bool captures = mode != GenMode::Quiets;
+			constexpr bool quiets = mode != GenMode::Captures;
 			const bool noCheck = (checkmask == 0xffffffffffffffffull);
 
 			//All outside variables need to be in local scope as the Callback will change everything on enumeration
-			const uint64_t movableSquare = EnemyOrEmpty<white>(brd) & checkmask;
+			const uint64_t movableSquare = TargetSquares<mode, white>(brd) & checkmask;
 			const uint64_t brdOcc = brd.Occ();
 
 			//Kingmoves
 			{
+				if constexpr (mode != GenMode::All) kingatk &= TargetSquares<mode, white>(brd);
 				Bitloop(kingatk)
 				{
 					collector.KingMove(SquareOf(King<white>(brd)), SquareOf(kingatk));
 				}
 
 				//Castling
-				if (brd.status.CanCastleLeft()) {
-					if (noCheck && brd.status.CanCastleLeft(kingban, brdOcc, Rooks<white>(brd))) {
-						collector.KingCastleLeft();
+				if constexpr (quiets && CastleL) {
+					if (brd.status.CanCastleLeft()) {
+						if (noCheck && brd.status.CanCastleLeft(kingban, brdOcc, Rooks<white>(brd))) {
+							collector.KingCastleLeft();
+						}
 					}
 				}
-				if (brd.status.CanCastleRight()) {
-					if (noCheck && brd.status.CanCastleRight(kingban, brdOcc, Rooks<white>(brd))) {
-						collector.KingCastleRight();
+				if constexpr (quiets && CastleR) {
+					if (brd.status.CanCastleRight()) {
+						if (noCheck && brd.status.CanCastleRight(kingban, brdOcc, Rooks<white>(brd))) {
+							collector.KingCastleRight();
+						}
 					}
 				}
 			}
@@ -381,8 +443,19 @@ namespace Gigantua{
 				Pawn_PruneMove<white>(Fpawns, rookPin);
 				Pawn_PruneMove2<white>(Ppawns, rookPin);
 
+				//Pawn captures and promotions are tactical - single steps and pushes are quiet
+				if constexpr (!quiets) {
+					Fpawns &= Pawns_LastRank<white>();
+					Ppawns = 0;
+				}
+				if constexpr (!captures) {
+					Lpawns = 0;
+					Rpawns = 0;
+					Fpawns &= ~Pawns_LastRank<white>();
+				}
+
 				//This is Enpassant
-				if (epTarget) {
+				if (captures && HasEP && epTarget) {
 					//The eppawn must be an enemy since its only ever valid for a single move
 					uint64_t EPLpawn = pawnsLR & Pawns_NotLeft() & ((epTarget & checkmask) >> 1); //Pawn that can EPTake to the left - overflow will not matter because 'Notleft'
 					uint64_t EPRpawn = pawnsLR & Pawns_NotRight() & ((epTarget & checkmask) << 1);  //Pawn that can EPTake to the right - overflow will not matter because 'NotRight'
@@ -433,7 +506,7 @@ namespace Gigantua{
 				uint64_t knights = Knights<white>(brd) & ~(rookPin | bishopPin); //A pinned knight cannot move
 				Bitloop(knights) {
 					const uint8_t sq = SquareOf(knights);
-					uint64_t move = Lookup::Knight(sq) & movableSquare;
+					uint64_t move = TLookup::Knight(sq) & movableSquare;
 
 					Bitloop(move) { collector.KnightMove(sq, SquareOf(move)); }
 				}
@@ -451,14 +524,14 @@ namespace Gigantua{
 				uint64_t bish_nopin = bishops & ~bishopPin;
 				Bitloop(bish_pinned) {
 					const uint8_t sq = SquareOf(bish_pinned);
-					uint64_t move = Lookup::Bishop(sq, brdOcc) & movableSquare & bishopPin; //A D12 pinned bishop can only move along D12 pinned axis
+					uint64_t move = TLookup::Bishop(sq, brdOcc) & movableSquare & bishopPin; //A D12 pinned bishop can only move along D12 pinned axis
 
 					if ((1ull << sq) & queens) { Bitloop(move) { collector.QueenMove(sq, SquareOf(move)); } }
 					else { Bitloop(move) { collector.BishopMove(sq, SquareOf(move)); } }
 				}
 				Bitloop(bish_nopin) {
 					const uint8_t sq = SquareOf(bish_nopin);
-					uint64_t move = Lookup::Bishop(sq, brdOcc) & movableSquare;
+					uint64_t move = TLookup::Bishop(sq, brdOcc) & movableSquare;
 
 					while (move) { const uint64_t to = PopBit(move); collector.BishopMove(sq, SquareOf(to)); }
 				}
@@ -472,14 +545,14 @@ namespace Gigantua{
 				uint64_t rook_nopin = rooks & ~rookPin;
 				Bitloop(rook_pinned) {
 					const uint8_t sq = SquareOf(rook_pinned);
-					uint64_t move = Lookup::Rook(sq, brdOcc) & movableSquare & rookPin; //A HV pinned rook can only move along HV pinned axis
+					uint64_t move = TLookup::Rook(sq, brdOcc) & movableSquare & rookPin; //A HV pinned rook can only move along HV pinned axis
 
 					if ((1ull << sq) & queens) { Bitloop(move) { collector.QueenMove(sq, SquareOf(move)); } }
 					else { Bitloop(move) { collector.RookMove(sq, SquareOf(move)); } }
 				}
 				Bitloop(rook_nopin) {
 					const uint8_t sq = SquareOf(rook_nopin);
-					uint64_t move = Lookup::Rook(sq, brdOcc) & movableSquare; //A HV pinned rook can only move along HV pinned axis
+					uint64_t move = TLookup::Rook(sq, brdOcc) & movableSquare; //A HV pinned rook can only move along HV pinned axis
 
 					Bitloop(move) { collector.RookMove(sq, SquareOf(move)); }
 				}
@@ -489,7 +562,7 @@ namespace Gigantua{
 				uint64_t queens = Queens<white>(brd) & ~(rookPin | bishopPin);
 				Bitloop(queens) {
 					const uint8_t sq = SquareOf(queens);
-					uint64_t move = Lookup::Queen(sq, brdOcc) & movableSquare;
+					uint64_t move = TLookup::Queen(sq, brdOcc) & movableSquare;
 
 					Bitloop(move) {collector.QueenMove(sq, SquareOf(move)); }
 				}
@@ -497,8 +570,8 @@ namespace Gigantua{
 		}
 
 
-		template<class TCollector, bool white>
-		static void EnumerateMoves(TCollector& collector, const Board& brd)
+		template<class TCollector, bool white, GenMode mode, bool HasEP, bool CastleL, bool CastleR, class TLookup>
+		_ForceInline void _enumerateStatus(TCollector& collector, const Board& brd)
 		{
 			constexpr bool enemy = !white;
 
@@ -515,18 +588,60 @@ namespace Gigantua{
 
 			//Calculate Check from enemy knights
 			{
-				const uint64_t knightcheck = Lookup::Knight(SquareOf(King<white>(brd))) & Knights<enemy>(brd);
+				const uint64_t knightcheck = TLookup::Knight(SquareOf(King<white>(brd))) & Knights<enemy>(brd);
 				if (knightcheck) checkmask = knightcheck;
 			}
 
-			uint64_t kingban = Lookup::King(SquareOf(King<enemy>(brd)));
-			uint64_t epTarget = brd.status.EnPassantTarget();
+			uint64_t kingban = TLookup::King(SquareOf(King<enemy>(brd)));
+			uint64_t epTarget = HasEP ? brd.status.EnPassantTarget() : 0ull; //A constant 0 removes the enpassant pin logic from Refresh
 			uint64_t rookPin = 0ull;
 			uint64_t bishopPin = 0ull;
 
-			uint64_t kingatk = Refresh<white>(brd, kingban, checkmask, epTarget, rookPin, bishopPin);
+			uint64_t kingatk = Refresh<white, TLookup>(brd, kingban, checkmask, epTarget, rookPin, bishopPin);
+
+			_enumerate<TCollector, white, mode, HasEP, CastleL, CastleR, TLookup>(brd, kingatk, kingban, checkmask, epTarget, rookPin, bishopPin, collector);
+		}
+
+		//Maps the runtime status to one of 3 instantiations so impossible castling and enpassant code compiles away
+		template<class TCollector, bool white, GenMode mode, class TLookup>
+		_ForceInline void _enumerateLookup(TCollector& collector, const Board& brd)
+		{
+			const bool castle = white ? (brd.status.WCastleL() || brd.status.WCastleR()) : (brd.status.BCastleL() || brd.status.BCastleR());
+
+			if (brd.status.EnPassantTarget()) [[unlikely]] _enumerateStatus<TCollector, white, mode, true, true, true, TLookup>(collector, brd);
+			else if (castle) _enumerateStatus<TCollector, white, mode, false, true, true, TLookup>(collector, brd);
+			else _enumerateStatus<TCollector, white, mode, false, false, false, TLookup>(collector, brd);
+		}
+
+		//The pext generators are the only code compiled for bmi2, reached only when Lookup picked pext
+		template<class TCollector, bool white, GenMode mode>
+		_TargetBMI2 static void _enumeratePext(TCollector& collector, const Board& brd)
+		{
+			_enumerateStatus<TCollector, white, mode, true, true, true, PextLookup>(collector, brd);
+		}
+
+		template<class TCollector, bool white, GenMode mode>
+		_TargetBMI2 static void _enumeratePextSpecialized(TCollector& collector, const Board& brd)
+		{
+			_enumerateLookup<TCollector, white, mode, PextLookup>(collector, brd);
+		}
+
+		//The slider backend is picked once per call - each backend has its own fully inlined generator.
+		//Castling and enpassant are tested at runtime: the status specialization below measured slower in perft
+		template<class TCollector, bool white, GenMode mode = GenMode::All>
+		static void EnumerateMoves(TCollector& collector, const Board& brd)
+		{
+			if (Lookup::Active() == LookupBackend::Magic) _enumerateStatus<TCollector, white, mode, true, true, true, MagicLookup>(collector, brd);
+			else _enumeratePext<TCollector, white, mode>(collector, brd);
+		}
 
-			_enumerate<TCollector, white>(brd, kingatk, kingban, checkmask, epTarget, rookPin, bishopPin, collector);
+		//One instantiation per castling/enpassant status - impossible blocks compile away, at the cost of 3x the code.
+		//Kept to measure against EnumerateMoves (GigantuaTest SpecializationPerfT)
+		template<class TCollector, bool white, GenMode mode = GenMode::All>
+		static void EnumerateMovesSpecialized(TCollector& collector, const Board& brd)
+		{
+			if (Lookup::Active() == LookupBackend::Magic) _enumerateLookup<TCollector, white, mode, MagicLookup>(collector, brd);
+			else _enumeratePextSpecialized<TCollector, white, mode>(collector, brd);
 		}
 
 		template<bool white>
@@ -712,21 +827,379 @@ namespace Gigantua{
 			return false;
 		}
 
+		template<bool IsWhite>
+		_Compiletime uint64_t PawnAttacks(uint64_t pawns)
+		{
+			return Pawn_AttackLeft<IsWhite>(pawns & Pawns_NotLeft()) | Pawn_AttackRight<IsWhite>(pawns & Pawns_NotRight());
+		}
+
+		_ForceInline uint64_t KnightAttacks(uint64_t knights)
+		{
+			uint64_t atk = 0;
+			Bitloop(knights) {
+				atk |= Lookup::Knight(SquareOf(knights));
+			}
+			return atk;
+		}
+
+		//Per node data to answer "does this move give check" and "does this move attack a piece" without playing it
+		//Checking squares per piece and discovered check blockers are computed once for the enemy king
+		template<bool white>
+		class CheckInfo
+		{
+		private:
+			const Board& brd;
+			const uint64_t occ;
+			const uint8_t kingsq;
+			uint64_t pawnCheck;
+			uint64_t knightCheck;
+			uint64_t bishopCheck;
+			uint64_t rookCheck;
+			uint64_t blockers = 0; //Own pieces that uncover a check from an own slider when they leave the line
+			uint64_t pawnAtk;
+			uint64_t knightAtk;
+
+			_ForceInline bool SliderCheck(uint64_t occAfter, uint64_t removed) const
+			{
+				return (Lookup::Rook(kingsq, occAfter) & RookQueen<white>(brd) & ~removed)
+					|| (Lookup::Bishop(kingsq, occAfter) & BishopQueen<white>(brd) & ~removed);
+			}
+
+			template<BoardPiece piece>
+			_ForceInline bool PromoteCheck(uint64_t from, uint64_t to) const
+			{
+				const uint64_t occAfter = (occ ^ from) | to;
+				const uint64_t king = EnemyKing<white>(brd);
+				if constexpr (piece == BoardPiece::Knight) return Lookup::Knight(SquareOf(to)) & king;
+				if constexpr (piece == BoardPiece::Bishop) return Lookup::Bishop(SquareOf(to), occAfter) & king;
+				if constexpr (piece == BoardPiece::Rook) return Lookup::Rook(SquareOf(to), occAfter) & king;
+				if constexpr (piece == BoardPiece::Queen) return Lookup::Queen(SquareOf(to), occAfter) & king;
+			}
+
+		public:
+			CheckInfo(const Board& brd) : brd(brd), occ(brd.Occ()), kingsq(SquareOf(EnemyKing<white>(brd)))
+			{
+				const uint64_t king = EnemyKing<white>(brd);
+				pawnCheck = Pawn_InvertLeft<white>(king & Pawns_NotRight()) | Pawn_InvertRight<white>(king & Pawns_NotLeft());
+				knightCheck = Lookup::Knight(kingsq);
+				bishopCheck = Lookup::Bishop(kingsq, occ);
+				rookCheck = Lookup::Rook(kingsq, occ);
+
+				uint64_t sliders = (Lookup::Rook_Xray(kingsq, occ) & RookQueen<white>(brd)) | (Lookup::Bishop_Xray(kingsq, occ) & BishopQueen<white>(brd));
+				Bitloop(sliders) {
+					const uint8_t sq = SquareOf(sliders);
+					blockers |= ChessLookup::PinBetween[kingsq * 64 + sq] & OwnColor<white>(brd) & ~(1ull << sq);
+				}
+
+				pawnAtk = PawnAttacks<white>(Pawns<white>(brd));
+				knightAtk = KnightAttacks(Knights<white>(brd));
+			}
+
+			bool GivesCheck(const Board::Move<white> move) const
+			{
+				const uint64_t from = 1ull << move.from();
+				const uint64_t to = 1ull << move.to();
+
+				switch (move.type())
+				{
+				case MoveType::PawnMove:
+				case MoveType::PawnAtk:
+				case MoveType::PawnPush:
+					if (to & pawnCheck) return true;
+					break;
+				case MoveType::KnightMove:
+					if (to & knightCheck) return true;
+					break;
+				case MoveType::BishopMove:
+					if (to & bishopCheck) return true;
+					break;
+				case MoveType::RookMove:
+					if (to & rookCheck) return true;
+					break;
+				case MoveType::QueenMove:
+					if (to & (bishopCheck | rookCheck)) return true;
+					break;
+				case MoveType::KingMove:
+					break;
+				case MoveType::KnightMovePromote:
+					if (PromoteCheck<BoardPiece::Knight>(from, to)) return true;
+					break;
+				case MoveType::BishopMovePromote:
+					if (PromoteCheck<BoardPiece::Bishop>(from, to)) return true;
+					break;
+				case MoveType::RookMovePromote:
+					if (PromoteCheck<BoardPiece::Rook>(from, to)) return true;
+					break;
+				case MoveType::QueenMovePromote:
+					if (PromoteCheck<BoardPiece::Queen>(from, to)) return true;
+					break;
+				case MoveType::PawnEnpassantTake:
+				{
+					//The taken pawn leaves a second square - can uncover a check that no blocker predicts
+					const uint64_t taken = Pawn_Backward<white>(to);
+					if (to & pawnCheck) return true;
+					return SliderCheck((occ ^ from ^ taken) | to, from);
+				}
+				case MoveType::KingCastleLeft:
+				case MoveType::KingCastleRight:
+				{
+					const uint64_t rookswitch = move.type() == MoveType::KingCastleLeft ? brd.status.Castle_RookswitchL() : brd.status.Castle_RookswitchR();
+					const uint64_t rookFrom = rookswitch & occ;
+					const uint64_t rookTo = rookswitch ^ rookFrom;
+					const uint64_t occAfter = (occ ^ from ^ rookFrom) | to | rookTo;
+					if (Lookup::Rook(SquareOf(rookTo), occAfter) & EnemyKing<white>(brd)) return true;
+					return SliderCheck(occAfter, rookFrom);
+				}
+				default:
+					break;
+				}
+
+				if (from & blockers) return SliderCheck((occ ^ from) | to, from);
+				return false;
+			}
+
+			//Highest enemy piece (queen, rook, knight, bishop) that gets newly attacked by an own pawn or knight after the move
+			//Knights only count pawn attacks - a knight attacking a knight is attacked back
+			BoardPiece Threat(const Board::Move<white> move) const
+			{
+				const uint64_t from = 1ull << move.from();
+				const uint64_t to = 1ull << move.to();
+
+				uint64_t pawns = Pawns<white>(brd);
+				uint64_t knights = Knights<white>(brd);
+				switch (move.type())
+				{
+				case MoveType::PawnMove:
+				case MoveType::PawnAtk:
+				case MoveType::PawnPush:
+				case MoveType::PawnEnpassantTake:
+					pawns ^= from | to;
+					break;
+				case MoveType::KnightMove:
+					knights ^= from | to;
+					break;
+				case MoveType::KnightMovePromote:
+					pawns ^= from;
+					knights |= to;
+					break;
+				case MoveType::BishopMovePromote:
+				case MoveType::RookMovePromote:
+				case MoveType::QueenMovePromote:
+					pawns ^= from;
+					break;
+				default:
+					return BoardPiece::None;
+				}
+
+				const uint64_t pawnAfter = PawnAttacks<white>(pawns);
+				const uint64_t minorAfter = pawnAfter | KnightAttacks(knights);
+				const uint64_t minorBefore = pawnAtk | knightAtk;
+
+				if (!(minorBefore & Queens<!white>(brd)) && (minorAfter & Queens<!white>(brd) & ~to)) return BoardPiece::Queen;
+				if (!(minorBefore & Rooks<!white>(brd)) && (minorAfter & Rooks<!white>(brd) & ~to)) return BoardPiece::Rook;
+				if (!(pawnAtk & Knights<!white>(brd)) && (pawnAfter & Knights<!white>(brd) & ~to)) return BoardPiece::Knight;
+				if (!(minorBefore & Bishops<!white>(brd)) && (minorAfter & Bishops<!white>(brd) & ~to)) return BoardPiece::Bishop;
+				return BoardPiece::None;
+			}
+		};
+
+		//Static exchange evaluation - same piece values as the search uses for captures
+		static constexpr std::array<int32_t, 7> SeeValue = { 136, 782, 830, 1289, 2529, 20000, 0 };
+
+		class StaticExchange
+		{
+		private:
+			const Board& brd;
+			const uint8_t sq;
+			uint64_t occ;
+			uint64_t attackers;
+			uint64_t pinned[2] = { 0, 0 }; //[white] pieces pinned to their own king
+			uint64_t pinners[2] = { 0, 0 }; //[white] sliders pinning an enemy piece
+
+			template<bool IsWhite>
+			_ForceInline void RegisterPins()
+			{
+				const uint8_t kingsq = SquareOf(King<IsWhite>(brd));
+				uint64_t sliders = (Lookup::Rook_Xray(kingsq, occ) & EnemyRookQueen<IsWhite>(brd)) | (Lookup::Bishop_Xray(kingsq, occ) & EnemyBishopQueen<IsWhite>(brd));
+				Bitloop(sliders) {
+					const uint8_t pinner = SquareOf(sliders);
+					const uint64_t pin = ChessLookup::PinBetween[kingsq * 64 + pinner] & OwnColor<IsWhite>(brd);
+					if (pin) {
+						pinned[IsWhite] |= pin;
+						pinners[!IsWhite] |= 1ull << pinner;
+					}
+				}
+			}
+
+			//All pieces of both colors that attack sq with the given occupancy
+			_ForceInline uint64_t AttackersTo(uint64_t occupied) const
+			{
+				const uint64_t target = 1ull << sq;
+				const uint64_t wpawns = Pawn_InvertLeft<true>(target & Pawns_NotRight()) | Pawn_InvertRight<true>(target & Pawns_NotLeft());
+				const uint64_t bpawns = Pawn_InvertLeft<false>(target & Pawns_NotRight()) | Pawn_InvertRight<false>(target & Pawns_NotLeft());
+
+				return (wpawns & brd.WPawn) | (bpawns & brd.BPawn)
+					| (Lookup::Knight(sq) & (brd.WKnight | brd.BKnight))
+					| (Lookup::King(sq) & (brd.WKing | brd.BKing))
+					| (Lookup::Bishop(sq, occupied) & (BishopQueen<true>(brd) | BishopQueen<false>(brd)))
+					| (Lookup::Rook(sq, occupied) & (RookQueen<true>(brd) | RookQueen<false>(brd)));
+			}
+
+			//Least valuable attacker of one side - removes it from the board and uncovers x-ray attackers behind it
+			template<bool IsWhite>
+			_ForceInline BoardPiece PopLeastValuable(uint64_t sideAttackers)
+			{
+				BoardPiece piece = BoardPiece::King;
+				uint64_t bit = sideAttackers & King<IsWhite>(brd);
+				if (uint64_t b = sideAttackers & Pawns<IsWhite>(brd)) { piece = BoardPiece::Pawn; bit = b; }
+				else if (uint64_t b = sideAttackers & Knights<IsWhite>(brd)) { piece = BoardPiece::Knight; bit = b; }
+				else if (uint64_t b = sideAttackers & Bishops<IsWhite>(brd)) { piece = BoardPiece::Bishop; bit = b; }
+				else if (uint64_t b = sideAttackers & Rooks<IsWhite>(brd)) { piece = BoardPiece::Rook; bit = b; }
+				else if (uint64_t b = sideAttackers & Queens<IsWhite>(brd)) { piece = BoardPiece::Queen; bit = b; }
+
+				occ ^= bit & (0 - bit);
+				if (piece == BoardPiece::Pawn || piece == BoardPiece::Bishop || piece == BoardPiece::Queen)
+					attackers |= Lookup::Bishop(sq, occ) & (BishopQueen<true>(brd) | BishopQueen<false>(brd));
+				if (piece == BoardPiece::Rook || piece == BoardPiece::Queen)
+					attackers |= Lookup::Rook(sq, occ) & (RookQueen<true>(brd) | RookQueen<false>(brd));
+				attackers &= occ;
+				return piece;
+			}
+
+			//Attackers that may legally take: pinned pieces stay out while their pinner is on the board
+			_ForceInline uint64_t SideAttackers(bool side) const
+			{
+				uint64_t result = attackers & (side ? brd.White() : brd.Black());
+				if (pinners[!side] & occ) result &= ~pinned[side];
+				return result;
+			}
+
+		public:
+			int32_t gain; //Material won by the first capture (promotion included)
+			int32_t onSquare; //Value of the piece that stands on the square after the first capture
+
+			template<bool white>
+			StaticExchange(const Board& brd, const Board::Move<white> move) : brd(brd), sq(move.to()), occ(brd.Occ())
+			{
+				const MoveType type = move.type();
+				gain = SeeValue[int(move.captured(brd))];
+				onSquare = SeeValue[int(move.who(brd))];
+
+				if (type >= MoveType::KnightMovePromote) {
+					const int32_t promoted = SeeValue[int(type) - int(MoveType::KnightMovePromote) + int(BoardPiece::Knight)];
+					gain += promoted - SeeValue[int(BoardPiece::Pawn)];
+					onSquare = promoted;
+				}
+				if (type == MoveType::PawnEnpassantTake) occ ^= Pawn_Backward<white>(1ull << sq);
+
+				RegisterPins<true>();
+				RegisterPins<false>();
+
+				occ &= ~((1ull << move.from()) | (1ull << sq));
+				attackers = AttackersTo(occ) & occ;
+			}
+
+			//Exact balance of the exchange with both sides free to stop capturing
+			template<bool white>
+			int32_t Evaluate()
+			{
+				std::array<int32_t, 32> swap;
+				swap[0] = gain;
+				int32_t last = onSquare;
+				bool side = !white;
+				int d = 0;
+
+				while (d < 31) {
+					const uint64_t sideAttackers = SideAttackers(side);
+					if (!sideAttackers) break;
+
+					//The king can only take the last defender
+					if ((sideAttackers & (side ? brd.WKing : brd.BKing)) == sideAttackers && (attackers & (side ? brd.Black() : brd.White()))) break;
+
+					d++;
+					swap[d] = last - swap[d - 1];
+					last = SeeValue[int(side ? PopLeastValuable<true>(sideAttackers) : PopLeastValuable<false>(sideAttackers))];
+					side = !side;
+				}
+
+				while (d > 0) {
+					swap[d - 1] = -std::max(-swap[d - 1], swap[d]);
+					d--;
+				}
+				return swap[0];
+			}
+
+			//Does the exchange win at least threshold - stops as soon as the answer is known
+			template<bool white>
+			bool GreaterEqual(int32_t threshold)
+			{
+				int32_t swap = gain - threshold;
+				if (swap < 0) return false;
+
+				swap = onSquare - swap;
+				if (swap <= 0) return true;
+
+				bool side = white;
+				int32_t result = 1;
+				while (true) {
+					side = !side;
+					const uint64_t sideAttackers = SideAttackers(side);
+					if (!sideAttackers) break;
+
+					result ^= 1;
+					const BoardPiece piece = side ? PopLeastValuable<true>(sideAttackers) : PopLeastValuable<false>(sideAttackers);
+
+					//A king may only take when nothing can take back
+					if (piece == BoardPiece::King) return (attackers & (side ? brd.Black() : brd.White())) ? result ^ 1 : result;
+
+					swap = SeeValue[int(piece)] - swap;
+					if (swap < result) break;
+				}
+				return result;
+			}
+		};
+
+		template<bool white>
+		static int32_t SEE(const Board& brd, const Board::Move<white> move)
+		{
+			if (move.type() == MoveType::KingCastleLeft || move.type() == MoveType::KingCastleRight) return 0;
+			StaticExchange see(brd, move);
+			return see.Evaluate<white>();
+		}
+
 		template<bool white>
+		static bool SEE_GE(const Board& brd, const Board::Move<white> move, int32_t threshold = 0)
+		{
+			if (move.type() == MoveType::KingCastleLeft || move.type() == MoveType::KingCastleRight) return 0 >= threshold;
+			StaticExchange see(brd, move);
+			return see.GreaterEqual<white>(threshold);
+		}
+
+		template<bool white, GenMode mode = GenMode::All>
 		static size_t MovesCount(const Board& brd)
 		{
 			MoveSizeCollector<white> collector;
-			EnumerateMoves<MoveSizeCollector<white>, white>(collector, brd);
+			EnumerateMoves<MoveSizeCollector<white>, white, mode>(collector, brd);
 			return collector.moves;
 		}
 
 
+		//Is move one of the legal moves in brd - for moves from hash tables that may belong to another position
 		template<bool white>
-		static std::vector<Board::Move<white>> MoveList(const Board& brd)
+		static bool IsLegal(const Board& brd, uint16_t move)
 		{
-			MoveCollector<white> collector;
-			EnumerateMoves<MoveCollector<white>, white>(collector, brd);
-			return collector.moves;
+			MoveFinder<white> finder(move);
+			EnumerateMoves<MoveFinder<white>, white>(finder, brd);
+			return finder.found;
+		}
+
+		template<bool white, GenMode mode = GenMode::All>
+		static MoveArray<white> MoveList(const Board& brd)
+		{
+			MoveArray<white> moves;
+			MoveCollector<white> collector(moves);
+			EnumerateMoves<MoveCollector<white>, white, mode>(collector, brd);
+			return moves;
 		}
 
 	}//namespace MoveList
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <assert.h>
+#include <immintrin.h>
+#include "MagicLookup.hpp"
+
+//Pext slider lookups with their own tables, so only these functions need bmi2. The binary is built for plain x86-64:
+//the lookups carry a bmi2 target attribute and whatever inlines them (the pext move generator) is compiled for bmi2.
+//Callers only reach them after Gigantua::Lookup found bmi2 on the cpu.
+//MSVC accepts any intrinsic without a target attribute
+#if defined(__GNUC__) || defined(__clang__)
+#define _TargetBMI2 __attribute__((target("bmi,bmi2")))
+#else
+#define _TargetBMI2
+#endif
+
+namespace ChessLookup {
+namespace LookupBmi2 {
+
+	namespace detail {
+		struct Pext {
+			const uint64_t* attacks;
+			uint64_t mask;
+		};
+
+		template<size_t TableSize>
+		struct Slider {
+			std::array<Pext, 64> squares;
+			std::array<uint64_t, TableSize> table;
+
+			Slider(const int (&dirs)[4][2])
+			{
+				size_t offset = 0;
+				for (int sq = 0; sq < 64; sq++) {
+					Pext& p = squares[sq];
+					p.mask = LookupMagic::detail::Walk(sq, dirs, 0, false);
+					p.attacks = table.data() + offset;
+
+					//The carry rippler visits the subsets in increasing order, the n-th one has pext index n - filled without pext
+					uint64_t occ = 0;
+					do {
+						table[offset++] = LookupMagic::detail::Walk(sq, dirs, occ, true);
+						occ = (occ - p.mask) & p.mask;
+					} while (occ);
+				}
+				assert(offset == TableSize);
+			}
+		};
+
+		inline const Slider<0x19000> Rooks(LookupMagic::detail::RookDirs);
+		inline const Slider<0x1480> Bishops(LookupMagic::detail::BishopDirs);
+	}
+
+	_TargetBMI2 inline uint64_t Rook(int sq, uint64_t occ) {
+		const detail::Pext& p = detail::Rooks.squares[sq];
+		return p.attacks[_pext_u64(occ, p.mask)];
+	}
+
+	_TargetBMI2 inline uint64_t Bishop(int sq, uint64_t occ) {
+		const detail::Pext& p = detail::Bishops.squares[sq];
+		return p.attacks[_pext_u64(occ, p.mask)];
+	}
+
+	_TargetBMI2 inline uint64_t Queen(int sq, uint64_t occ) {
+		return Rook(sq, occ) | Bishop(sq, occ);
+	}
+
+	//Squares that become visible once the first blockers are removed
+	_TargetBMI2 inline uint64_t Rook_Xray(int sq, uint64_t occ) {
+		const uint64_t atk = Rook(sq, occ);
+		return atk ^ Rook(sq, occ ^ (occ & atk));
+	}
+
+	_TargetBMI2 inline uint64_t Bishop_Xray(int sq, uint64_t occ) {
+		const uint64_t atk = Bishop(sq, occ);
+		return atk ^ Bishop(sq, occ ^ (occ & atk));
+	}
+}
+}
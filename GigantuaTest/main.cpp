@@ -2,11 +2,69 @@
 #include <chrono>
 #include <random>
 #include <cstring>
+#include <thread>
+#include <atomic>
+#include <numeric>
+#include <memory>
+#include <algorithm>
+#include <climits>
+#include <deque>
+#include <mutex>
 
 #include <../Gigantua/MoveList.hpp>
 #include <../Gigantua/ChessTest.hpp>
+#include <../Gigantua/Epd.hpp>
+#include <../Search/TTable.hpp>
 
-static inline uint64_t nodes;
+//Per thread node counter. The main thread holds the total after _PerfT
+static inline thread_local uint64_t nodes;
+static inline unsigned threadsNum = 1;
+static inline int splitDepth = 1;
+//Uses the castling/enpassant status dispatch instead of the single runtime-checked generator
+static inline bool specializedGen = false;
+
+//Subtree counts keyed by Board::Hash and depth. Lock-free: an entry stores key ^ data next to data,
+//a torn read from a concurrent writer fails the key check and is treated as a miss
+struct PerfTTable {
+	struct Entry {
+		std::atomic<uint64_t> check = 0;
+		std::atomic<uint64_t> data = 0; //count << 8 | depth
+	};
+
+	std::unique_ptr<Entry[]> table;
+	uint64_t mask = 0;
+
+	bool Enabled() const { return mask != 0; }
+
+	void Resize(size_t megabytes) {
+		size_t size = 1;
+		while (size * 2 * sizeof(Entry) <= megabytes * 1024 * 1024) size *= 2;
+
+		table.reset(size > 1 ? new Entry[size] : nullptr);
+		mask = size > 1 ? size - 1 : 0;
+	}
+
+	size_t SizeMB() const { return table ? (mask + 1) * sizeof(Entry) / (1024 * 1024) : 0; }
+
+	bool Get(uint64_t hash, int depth, uint64_t& count) const {
+		const Entry& entry = table[hash & mask];
+		const uint64_t data = entry.data.load(std::memory_order_relaxed);
+		const uint64_t check = entry.check.load(std::memory_order_relaxed);
+
+		if ((check ^ data) != hash || (data & 0xff) != uint64_t(depth)) return false;
+		count = data >> 8;
+		return true;
+	}
+
+	void Put(uint64_t hash, int depth, uint64_t count) {
+		Entry& entry = table[hash & mask];
+		const uint64_t data = (count << 8) | uint64_t(depth);
+		entry.data.store(data, std::memory_order_relaxed);
+		entry.check.store(hash ^ data, std::memory_order_relaxed);
+	}
+};
+
+static inline PerfTTable perftTable;
 
 template<bool white>
 static void PerfT(const Gigantua::Board& brd, int depth);
@@ -22,22 +80,395 @@ public:
 
 	void CollectImpl(const Gigantua::Board::Move<white>& move) const
 	{
-		PerfT<!white>(move.play(m_brd), m_depth - 1);
+		//Next level only counts moves and never reads the hash
+		if (m_depth == 2) PerfT<!white>(move.template play<false>(m_brd), 1);
+		else PerfT<!white>(move.play(m_brd), m_depth - 1);
+	}
+};
+
+template<bool white>
+static bool HashTest(const Gigantua::Board& brd, int depth);
+
+template<bool white>
+class HashTestCollector : public Gigantua::MoveList::MoveCollectorBase<HashTestCollector<white>, white>
+{
+private:
+	const Gigantua::Board& m_brd;
+	const int m_depth;
+public:
+	mutable bool ok = true;
+	HashTestCollector(const Gigantua::Board& brd, int depth) : m_brd(brd), m_depth(depth) {}
+
+	void CollectImpl(const Gigantua::Board::Move<white>& move) const
+	{
+		const Gigantua::Board next = move.play(m_brd);
+		const Gigantua::Board full(next.BPawn, next.BKnight, next.BBishop, next.BRook, next.BQueen, next.BKing,
+			next.WPawn, next.WKnight, next.WBishop, next.WRook, next.WQueen, next.WKing, next.status);
+
+		if (next.Hash != full.Hash) ok = false;
+#ifdef MAILBOX_SUPPORT
+		if (next.Mailbox != full.Mailbox) ok = false;
+#endif
+		if (ok && m_depth > 1) ok = HashTest<!white>(next, m_depth - 1);
+	}
+};
+
+//Incremental Zobrist keys (and the mailbox) must match the ones computed from scratch
+template<bool white>
+static bool HashTest(const Gigantua::Board& brd, int depth)
+{
+	HashTestCollector<white> collector(brd, depth);
+	Gigantua::MoveList::EnumerateMoves<HashTestCollector<white>, white>(collector, brd);
+	return collector.ok;
+}
+
+template<bool white>
+static bool GivesCheckTest(const Gigantua::Board& brd, int depth);
+
+template<bool white>
+class GivesCheckCollector : public Gigantua::MoveList::MoveCollectorBase<GivesCheckCollector<white>, white>
+{
+private:
+	const Gigantua::Board& m_brd;
+	const Gigantua::MoveList::CheckInfo<white> m_info;
+	const int m_depth;
+public:
+	mutable bool ok = true;
+	GivesCheckCollector(const Gigantua::Board& brd, int depth) : m_brd(brd), m_info(brd), m_depth(depth) {}
+
+	void CollectImpl(const Gigantua::Board::Move<white>& move) const
+	{
+		using namespace Gigantua::MoveList;
+		const Gigantua::Board next = move.play(m_brd);
+		if (m_info.GivesCheck(move) != InCheck<!white>(next)) ok = false;
+
+		//Reference: piece class attacked after the move by own pawns/knights that was not attacked before
+		if (move.captured(m_brd) == Gigantua::BoardPiece::None && Bitcount(Gigantua::Queens<!white>(m_brd)) < 2) {
+			Gigantua::BoardPiece threat = Gigantua::BoardPiece::None;
+			if (!QueenInCheck<!white>(m_brd) && QueenInCheck<!white>(next)) threat = Gigantua::BoardPiece::Queen;
+			else if (!RookInCheck<!white>(m_brd) && RookInCheck<!white>(next)) threat = Gigantua::BoardPiece::Rook;
+			else if (!KnightInCheck<!white>(m_brd) && KnightInCheck<!white>(next)) threat = Gigantua::BoardPiece::Knight;
+			else if (!BishopInCheck<!white>(m_brd) && BishopInCheck<!white>(next)) threat = Gigantua::BoardPiece::Bishop;
+			if (m_info.Threat(move) != threat) ok = false;
+		}
+
+		if (ok && m_depth > 1) ok = GivesCheckTest<!white>(next, m_depth - 1);
 	}
 };
 
+//CheckInfo must agree with playing the move and testing the result
+template<bool white>
+static bool GivesCheckTest(const Gigantua::Board& brd, int depth)
+{
+	GivesCheckCollector<white> collector(brd, depth);
+	Gigantua::MoveList::EnumerateMoves<GivesCheckCollector<white>, white>(collector, brd);
+	return collector.ok;
+}
+
+//The threshold test must agree with the full swap list evaluation
+template<bool white>
+static bool SeeTest(const Gigantua::Board& brd)
+{
+	using namespace Gigantua::MoveList;
+	for (const auto& move : MoveList<white, GenMode::Captures>(brd)) {
+		const int32_t see = SEE(brd, move);
+		for (int32_t threshold : { -2529, -1289, -830, -136, 0, 1, 136, 782, 1289, 2529 }) {
+			if (SEE_GE(brd, move, threshold) != (see >= threshold)) return false;
+		}
+	}
+	return true;
+}
+
+//Captures and quiets must split the full move list exactly
+template<bool white>
+static bool GenModeTest(const Gigantua::Board& brd)
+{
+	using namespace Gigantua::MoveList;
+	const auto all = MoveList<white>(brd);
+	const auto captures = MoveList<white, GenMode::Captures>(brd);
+	const auto quiets = MoveList<white, GenMode::Quiets>(brd);
+	if (captures.size() + quiets.size() != all.size()) return false;
+
+	auto tactical = [&](const Gigantua::Board::Move<white>& move) {
+		return move.captured(brd) != Gigantua::BoardPiece::None || move.type() >= Gigantua::MoveType::KnightMovePromote;
+	};
+	for (const auto& move : captures) if (!tactical(move)) return false;
+	for (const auto& move : quiets) if (tactical(move)) return false;
+	return true;
+}
+
+//Magic slider lookups against pext for random occupancies on every square. Only the part of the xray behind the
+//first blockers is compared, that is what the pin detection uses
+_TargetBMI2 static bool LookupPextTest()
+{
+	using namespace Gigantua;
+	uint64_t occ = 0x2545F4914F6CDD1Dull;
+	for (int i = 0; i < 1 << 16; i++) {
+		occ ^= occ << 13; occ ^= occ >> 7; occ ^= occ << 17;
+		const int sq = i & 63;
+		const uint64_t board = (i & 64) ? occ : occ & (occ >> 17) & (occ >> 29);
+		if (MagicLookup::Rook(sq, board) != PextLookup::Rook(sq, board)) return false;
+		if (MagicLookup::Bishop(sq, board) != PextLookup::Bishop(sq, board)) return false;
+		if (MagicLookup::Queen(sq, board) != PextLookup::Queen(sq, board)) return false;
+		if ((MagicLookup::Rook_Xray(sq, board) & ~PextLookup::Rook(sq, board)) != (PextLookup::Rook_Xray(sq, board) & ~PextLookup::Rook(sq, board))) return false;
+		if ((MagicLookup::Bishop_Xray(sq, board) & ~PextLookup::Bishop(sq, board)) != (PextLookup::Bishop_Xray(sq, board) & ~PextLookup::Bishop(sq, board))) return false;
+	}
+	return true;
+}
+
+//Nothing to compare against without bmi2
+static bool LookupTest()
+{
+	return !Gigantua::Lookup::HasBmi2() || LookupPextTest();
+}
+
+//Single pass parser against the per piece scan it replaced, plus rejection of broken input
+static bool FenTest()
+{
+	using namespace Gigantua;
+	for (auto pos : Test::Positions) {
+		const auto fen = Test::GetElements(pos, ';')[0];
+		const Board scanned(FEN::FenToBmp(fen, 'p'), FEN::FenToBmp(fen, 'n'), FEN::FenToBmp(fen, 'b'), FEN::FenToBmp(fen, 'r'), FEN::FenToBmp(fen, 'q'), FEN::FenToBmp(fen, 'k'),
+			FEN::FenToBmp(fen, 'P'), FEN::FenToBmp(fen, 'N'), FEN::FenToBmp(fen, 'B'), FEN::FenToBmp(fen, 'R'), FEN::FenToBmp(fen, 'Q'), FEN::FenToBmp(fen, 'K'), BoardStatus(fen));
+		Board parsed;
+		if (Board::FromFen(fen, parsed) != FenError::None || parsed.Hash != scanned.Hash || parsed.status != scanned.status || parsed.Occ() != scanned.Occ()) return false;
+	}
+
+	FenPosition pos;
+	return FEN::Parse("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 12 34", pos) == FenError::None && pos.halfMove == 12 && pos.fullMove == 34 &&
+		FEN::Parse("rnbqkbnr/pppppppp/9/8/8/8/PPPPPPPP/RNBQKBNR w KQkq -", pos) == FenError::Placement && pos.length == 18 &&
+		FEN::Parse("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBN w KQkq -", pos) == FenError::Placement &&
+		FEN::Parse("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQQBNR w KQkq -", pos) == FenError::Kings &&
+		FEN::Parse("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR x KQkq -", pos) == FenError::SideToMove &&
+		FEN::Parse("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQxq -", pos) == FenError::Castling &&
+		FEN::Parse("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq e3", pos) == FenError::EnPassant &&
+		FEN::Parse("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w", pos) == FenError::Castling;
+}
+
+//Writes the ChessTest positions plus standard EPD opcodes to a file and streams them back
+static bool EpdTest()
+{
+	const char* path = "gigantua_epd_test.epd";
+	FILE* file = std::fopen(path, "wb");
+	if (!file) return false;
+	for (auto pos : Test::Positions) std::fprintf(file, "%s\n", pos.c_str());
+	std::fprintf(file, "\n# comment\n1k1r4/pp1b1R2/3q2pp/4p3/2B5/4Q3/PPP2B2/2K5 b - - bm Qd1+; id \"BK.01\";\r\n");
+	std::fprintf(file, "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq e3 bm e4;\n");
+	std::fclose(file);
+
+	bool ok = true;
+	{
+		Gigantua::EPD::Reader reader(path);
+		Gigantua::EPD::Record rec;
+		size_t i = 0;
+		for (; i < std::size(Test::Positions) && reader.Next(rec); i++) {
+			const auto v = Test::GetElements(Test::Positions[i], ';');
+			ok &= rec.error == Gigantua::FenError::None && rec.perftDepth == v.size() - 1 && rec.board().Hash == Gigantua::Board(v[0]).Hash;
+			for (size_t d = 1; d < v.size(); d++)
+				ok &= rec.perft[d] == std::strtoull(Test::GetElements(v[d], ' ')[1].c_str(), nullptr, 10);
+		}
+		ok &= i == std::size(Test::Positions);
+
+		ok &= reader.Next(rec) && rec.error == Gigantua::FenError::None && rec.bm == "Qd1+" && rec.id == "BK.01" && rec.am.empty();
+		ok &= reader.Next(rec) && rec.error == Gigantua::FenError::EnPassant && reader.Line() == std::size(Test::Positions) + 4;
+		ok &= !reader.Next(rec);
+	}
+	std::remove(path);
+	return ok;
+}
+
+//One bucket, so every key lands in it. Hashes are made up: the low half picks the bucket, the high half is the key
+static bool TTableTest()
+{
+	using TT = Search::TTable;
+	TT tt(TT::BucketSize);
+	TT::Stats stats;
+	uint16_t move;
+	int16_t eval;
+
+	const Gigantua::Board start("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+	const uint16_t legal = Gigantua::MoveList::MoveList<true>(start).begin()->move;
+	const uint16_t illegal = Gigantua::MoveList::MoveList<false>(Gigantua::Board("rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq - 0 1")).begin()->move;
+	const auto pos = [&](uint64_t key) {
+		Gigantua::Board brd = start;
+		brd.Hash = (key << 32) | 0x5a5a5a5aull;
+		return brd;
+	};
+	const auto entries = [&](const Gigantua::Board& brd) {
+		size_t n = 0;
+		for (const TT::Node& node : tt.hashTable[0]) n += TT::Node::KeyOf(node.smpKey ^ node.smpData) == TT::Node::KeyOf(brd.Hash);
+		return n;
+	};
+
+	bool ok = TT::IsLegal(start, legal) && !TT::IsLegal(start, illegal);
+
+	//Probes find all four slots
+	for (uint64_t k = 1; k <= 4; k++) tt.Put(pos(k), int(k), 0, 3, TT::Flag::Value, TT::NoEval, stats);
+	for (uint64_t k = 1; k <= 4; k++) ok &= tt.Get(pos(k), -100, 100, 3, move, eval, stats) == int(k);
+
+	//One entry per position, the deeper one stays
+	tt.Clear();
+	tt.Put(pos(1), 10, 0, 5, TT::Flag::Value, TT::NoEval, stats);
+	tt.Put(pos(1), 20, 0, 3, TT::Flag::Value, TT::NoEval, stats);
+	ok &= entries(pos(1)) == 1 && tt.Get(pos(1), -100, 100, 5, move, eval, stats) == 10;
+	tt.Put(pos(1), 30, 0, 7, TT::Flag::Value, TT::NoEval, stats);
+	ok &= entries(pos(1)) == 1 && tt.Get(pos(1), -100, 100, 7, move, eval, stats) == 30;
+
+	//A deep entry two searches old goes before the shallow ones of this search
+	tt.Clear();
+	tt.Put(pos(1), 1, 0, 6, TT::Flag::Value, TT::NoEval, stats);
+	tt.NewSearch();
+	tt.NewSearch();
+	for (uint64_t k = 2; k <= 4; k++) tt.Put(pos(k), int(k), 0, 2, TT::Flag::Value, TT::NoEval, stats);
+	tt.Put(pos(5), 5, 0, 2, TT::Flag::Value, TT::NoEval, stats);
+	ok &= entries(pos(1)) == 0;
+	for (uint64_t k = 2; k <= 5; k++) ok &= entries(pos(k)) == 1;
+
+	//No cutoff with a move that is illegal in the probed position
+	tt.Clear();
+	tt.Put(pos(1), 10, illegal, 5, TT::Flag::Value, TT::NoEval, stats);
+	ok &= tt.Get(pos(1), -100, 100, 5, move, eval, stats) == TT::NAN_VAL && tt.GetBestMove(pos(1)) == 0;
+	tt.Put(pos(1), 10, legal, 6, TT::Flag::Value, 42, stats);
+	ok &= tt.Get(pos(1), -100, 100, 5, move, eval, stats) == 10 && move == legal && eval == 42 && tt.GetBestMove(pos(1)) == legal;
+
+	//Same bucket with another key, and a torn write, are misses
+	ok &= tt.Get(pos(2), -100, 100, 0, move, eval, stats) == TT::NAN_VAL && eval == TT::NoEval;
+	tt.hashTable[0][0].smpData ^= 1ull << 40;
+	ok &= tt.Get(pos(1), -100, 100, 0, move, eval, stats) == TT::NAN_VAL && eval == TT::NoEval;
+	return ok;
+}
+
+//Load speed of an EPD file
+static void EpdBench(const char* path)
+{
+	auto start = std::chrono::steady_clock::now();
+	Gigantua::EPD::Reader reader(path);
+	if (!reader.IsOpen()) {
+		std::cout << "cannot open " << path << std::endl;
+		return;
+	}
+
+	Gigantua::EPD::Record rec;
+	uint64_t records = 0, errors = 0, check = 0;
+	while (reader.Next(rec)) {
+		records++;
+		if (rec.error != Gigantua::FenError::None) {
+			if (errors++ < 10) std::cout << "line " << reader.Line() << ": " << Gigantua::FenErrorStr(rec.error) << " at " << rec.position.length << "\n";
+			continue;
+		}
+		check ^= rec.board().Hash;
+	}
+	auto end = std::chrono::steady_clock::now();
+	long long delta = std::max(1ll, (long long)std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+	std::cout << "EPD " << records << " records " << errors << " errors " << delta / 1000 << "ms " << records * 1.0 / delta << " MRecords/s "
+		<< reader.Size() * 1.0 / delta << " MB/s (" << std::hex << check << std::dec << ")" << std::endl;
+}
+
 template<bool white>
 static void PerfT(const Gigantua::Board& brd, int depth)
 {
 	if(depth == 1){
-		nodes += Gigantua::MoveList::MovesCount<white>(brd);
+		if (specializedGen) {
+			Gigantua::MoveList::MoveSizeCollector<white> counter;
+			Gigantua::MoveList::EnumerateMovesSpecialized<Gigantua::MoveList::MoveSizeCollector<white>, white>(counter, brd);
+			nodes += counter.moves;
+		}
+		else nodes += Gigantua::MoveList::MovesCount<white>(brd);
 		return;
 	}
 
+	uint64_t count = 0;
+	if (perftTable.Enabled() && perftTable.Get(brd.Hash, depth, count)) {
+		nodes += count;
+		return;
+	}
+
+	const uint64_t before = nodes;
 	PerfTCollector<white> collector(brd, depth);
-	Gigantua::MoveList::EnumerateMoves<PerfTCollector<white>, white>(collector, brd);
+	if (specializedGen) Gigantua::MoveList::EnumerateMovesSpecialized<PerfTCollector<white>, white>(collector, brd);
+	else Gigantua::MoveList::EnumerateMoves<PerfTCollector<white>, white>(collector, brd);
+
+	if (perftTable.Enabled()) perftTable.Put(brd.Hash, depth, nodes - before);
+}
+
+
+template<bool white>
+static void SplitMoves(const Gigantua::Board& brd, int ply, std::vector<Gigantua::Board>& tasks);
+
+template<bool white>
+class SplitCollector : public Gigantua::MoveList::MoveCollectorBase<SplitCollector<white>, white>
+{
+private:
+	const Gigantua::Board& m_brd;
+	const int m_ply;
+	std::vector<Gigantua::Board>& m_tasks;
+public:
+	SplitCollector(const Gigantua::Board& brd, int ply, std::vector<Gigantua::Board>& tasks) : m_brd(brd), m_ply(ply), m_tasks(tasks) {}
+
+	void CollectImpl(const Gigantua::Board::Move<white>& move) const
+	{
+		if (m_ply == 1) m_tasks.push_back(move.play(m_brd));
+		else SplitMoves<!white>(move.play(m_brd), m_ply - 1, m_tasks);
+	}
+};
+
+//Collects all positions 'ply' moves below brd - these are the work items of the threaded perft
+template<bool white>
+static void SplitMoves(const Gigantua::Board& brd, int ply, std::vector<Gigantua::Board>& tasks)
+{
+	SplitCollector<white> collector(brd, ply, tasks);
+	Gigantua::MoveList::EnumerateMoves<SplitCollector<white>, white>(collector, brd);
 }
 
+//Subtrees waiting in one thread's queue. The owner works from the back, thieves take from the front
+struct PerfTQueue {
+	std::mutex lock;
+	std::deque<const Gigantua::Board*> items;
+
+	const Gigantua::Board* PopBack() {
+		std::lock_guard<std::mutex> guard(lock);
+		if (items.empty()) return nullptr;
+		const Gigantua::Board* item = items.back();
+		items.pop_back();
+		return item;
+	}
+
+	const Gigantua::Board* StealFront() {
+		std::lock_guard<std::mutex> guard(lock);
+		if (items.empty()) return nullptr;
+		const Gigantua::Board* item = items.front();
+		items.pop_front();
+		return item;
+	}
+};
+
+//Work stealing over the split positions: every thread starts with its share in its own deque and, once that is
+//empty, steals from the others until all are empty. Nothing is added after the start, so an empty round ends it
+template<bool white>
+static void PerfTParallel(const std::vector<Gigantua::Board>& tasks, int depth)
+{
+	std::vector<PerfTQueue> queues(threadsNum);
+	for (size_t i = 0; i < tasks.size(); i++) queues[i % threadsNum].items.push_back(&tasks[i]);
+
+	std::vector<uint64_t> counts(threadsNum, 0);
+	std::vector<std::thread> pool;
+
+	for (unsigned t = 0; t < threadsNum; t++) {
+		pool.emplace_back([&queues, &counts, depth, t]() {
+			nodes = 0;
+			for (;;) {
+				const Gigantua::Board* task = queues[t].PopBack();
+				for (unsigned v = 1; !task && v < threadsNum; v++) task = queues[(t + v) % threadsNum].StealFront();
+				if (!task) break;
+				PerfT<white>(*task, depth);
+			}
+			counts[t] = nodes;
+		});
+	}
+
+	for (auto& th : pool) th.join();
+	nodes = std::accumulate(counts.begin(), counts.end(), 0ull);
+}
 
 static inline void _PerfT(std::string_view fen, int depth) {
 	Gigantua::Board brd(fen);
@@ -50,6 +481,17 @@ static inline void _PerfT(std::string_view fen, int depth) {
 			break;
 		}
 
+	if (threadsNum > 1 && depth > splitDepth) {
+		std::vector<Gigantua::Board> tasks;
+		if (brd.status.WhiteMove()) SplitMoves<true>(brd, splitDepth, tasks);
+		else SplitMoves<false>(brd, splitDepth, tasks);
+
+		//Side to move at the split depth
+		if (brd.status.WhiteMove() != bool(splitDepth & 1)) PerfTParallel<true>(tasks, depth - splitDepth);
+		else PerfTParallel<false>(tasks, depth - splitDepth);
+		return;
+	}
+
 	if (brd.status.WhiteMove()) {
 		PerfT<true>(brd, depth);
 	}
@@ -79,8 +521,145 @@ void Chess_Test() {
 	}
 }
 
+//Regression/soak run of the start position to depth 9 and kiwipete to depth 7 - meant to be used with --hash
+static void DeepPerfT(int depth)
+{
+	static constexpr uint64_t startCounts[] = { 20ull, 400ull, 8902ull, 197281ull, 4865609ull, 119060324ull, 3195901860ull, 84998978956ull, 2439530234167ull };
+	static constexpr uint64_t kiwiCounts[] = { 48ull, 2039ull, 97862ull, 4085603ull, 193690690ull, 8031647685ull, 374190009323ull };
+
+	const std::string_view def = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+	const std::string_view kiwi = "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1";
+
+	for (int i = 1; i <= depth; i++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		_PerfT(def, i);
+		auto end = std::chrono::steady_clock::now();
+		long long delta = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+		std::cout << "Perft Deep Start " << i << ": " << nodes << " " << delta / 1000 << "ms " << nodes * 1.0 / delta << " MNodes/s "
+			<< (nodes == startCounts[i - 1] ? "OK" : "ERROR!") << "\n";
+	}
+
+	for (int i = 1; i <= std::min(depth, 7); i++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		_PerfT(kiwi, i);
+		auto end = std::chrono::steady_clock::now();
+		long long delta = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+		std::cout << "Perft Deep Kiwi " << i << ": " << nodes << " " << delta / 1000 << "ms " << nodes * 1.0 / delta << " MNodes/s "
+			<< (nodes == kiwiCounts[i - 1] ? "OK" : "ERROR!") << "\n";
+	}
+}
+
+//Same perft through the generic generator and through the castling/enpassant status dispatch.
+//Runs alternate and the best of 3 is kept so neither side profits from running first
+static void SpecializationPerfT(std::string_view name, std::string_view fen, int depth)
+{
+	long long best[2] = { LLONG_MAX, LLONG_MAX };
+	uint64_t counts[2];
+	for (int r = 0; r < 6; r++) {
+		const int i = r & 1;
+		specializedGen = i == 1;
+		auto start = std::chrono::steady_clock::now();
+		_PerfT(fen, depth);
+		auto end = std::chrono::steady_clock::now();
+		best[i] = std::min(best[i], (long long)std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+		counts[i] = nodes;
+	}
+	specializedGen = false;
+
+	std::cout << "Specialized " << name << " " << depth << ": generic " << best[0] / 1000 << "ms specialized " << best[1] / 1000 << "ms speedup "
+		<< best[0] * 1.0 / std::max(1ll, best[1]) << "x " << (counts[0] == counts[1] ? "OK" : "ERROR!") << "\n";
+}
+
+//Same perft on one thread and on --threads, alternating and best of 3 like SpecializationPerfT
+static void ThreadsPerfT(std::string_view name, std::string_view fen, int depth)
+{
+	const unsigned threads = threadsNum;
+	long long best[2] = { LLONG_MAX, LLONG_MAX };
+	uint64_t counts[2];
+	for (int r = 0; r < 6; r++) {
+		const int i = r & 1;
+		threadsNum = i == 0 ? 1 : threads;
+		auto start = std::chrono::steady_clock::now();
+		_PerfT(fen, depth);
+		auto end = std::chrono::steady_clock::now();
+		best[i] = std::min(best[i], (long long)std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+		counts[i] = nodes;
+	}
+	threadsNum = threads;
+
+	std::cout << "Threads " << name << " " << depth << ": 1 thread " << best[0] / 1000 << "ms " << threads << " threads " << best[1] / 1000 << "ms speedup "
+		<< best[0] * 1.0 / std::max(1ll, best[1]) << "x " << (counts[0] == counts[1] ? "OK" : "ERROR!") << "\n";
+}
+
+//Same perft with the pext and the magic generator, alternating and best of 3 like SpecializationPerfT
+static void LookupPerfT(std::string_view name, std::string_view fen, int depth)
+{
+	if (!Gigantua::Lookup::HasBmi2()) {
+		std::cout << "Lookup " << name << " " << depth << ": no bmi2, magic only\n";
+		return;
+	}
+	const Gigantua::LookupBackend active = Gigantua::Lookup::Active();
+	long long best[2] = { LLONG_MAX, LLONG_MAX };
+	uint64_t counts[2];
+	for (int r = 0; r < 6; r++) {
+		const int i = r & 1;
+		Gigantua::Lookup::Force(i == 0 ? Gigantua::LookupBackend::Pext : Gigantua::LookupBackend::Magic);
+		auto start = std::chrono::steady_clock::now();
+		_PerfT(fen, depth);
+		auto end = std::chrono::steady_clock::now();
+		best[i] = std::min(best[i], (long long)std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+		counts[i] = nodes;
+	}
+	Gigantua::Lookup::Force(active);
+
+	std::cout << "Lookup " << name << " " << depth << ": pext " << best[0] / 1000 << "ms magic " << best[1] / 1000 << "ms "
+		<< (counts[0] == counts[1] ? "OK" : "ERROR!") << "\n";
+}
+
 int main(int argc, char** argv)
 {
+	size_t hashMB = 0;
+	int deepDepth = 0;
+	const char* epdPath = nullptr;
+	for (int i = 1; i + 1 < argc; i++) {
+		if (std::strcmp(argv[i], "--threads") == 0) threadsNum = std::max(1, std::atoi(argv[++i]));
+		else if (std::strcmp(argv[i], "--split") == 0) splitDepth = std::max(1, std::atoi(argv[++i]));
+		else if (std::strcmp(argv[i], "--hash") == 0) hashMB = std::max(0, std::atoi(argv[++i]));
+		else if (std::strcmp(argv[i], "--deep") == 0) deepDepth = std::clamp(std::atoi(argv[++i]), 0, 9);
+		else if (std::strcmp(argv[i], "--epd") == 0) epdPath = argv[++i];
+		else if (std::strcmp(argv[i], "--lookup") == 0) {
+			const char* name = argv[++i];
+			const bool magic = std::strcmp(name, "magic") == 0;
+			if (!magic && std::strcmp(name, "pext") != 0) {
+				std::cout << "unknown lookup " << name << ", expected pext or magic" << std::endl;
+				return 1;
+			}
+			if (!Gigantua::Lookup::Force(magic ? Gigantua::LookupBackend::Magic : Gigantua::LookupBackend::Pext)) {
+				std::cout << "pext needs bmi2" << std::endl;
+				return 1;
+			}
+		}
+	}
+	perftTable.Resize(hashMB);
+#ifdef MAILBOX_SUPPORT
+	constexpr const char* mailbox = "on";
+#else
+	constexpr const char* mailbox = "off";
+#endif
+	std::cout << "Perft threads: " << threadsNum << " split depth: " << splitDepth << " hash: " << perftTable.SizeMB() << "MB mailbox: " << mailbox << " lookup: " << Gigantua::Lookup::BackendStr(Gigantua::Lookup::Active()) << std::endl;
+
+	if (epdPath) {
+		EpdBench(epdPath);
+		return 0;
+	}
+
+	if (deepDepth > 0) {
+		DeepPerfT(deepDepth);
+		return 0;
+	}
+
 	Gigantua::Board noCheckBrd1("rn1qkbnr/p2b1ppp/1p1p4/1Bp1p3/P2P2P1/2N1P3/1PP2P1P/R1BQK1NR b KQkq a3 0 6");
 	Gigantua::Board noCheckBrd2("rn1qk1nr/p2b1ppp/1p6/bB1pp1N1/P2p2P1/4P3/1PPB1P1P/R2QK1NR w KQkq - 4 10");
 	Gigantua::Board noCheckBrd3("rn4nr/p2b1p2/1p3kpp/bB4N1/P2p2P1/3K4/1PPB3P/R5NR w - - 0 18");
@@ -109,6 +688,102 @@ int main(int argc, char** argv)
 
 	std::cout << "check test OK" << std::endl;
 
+	bool hashTest = true;
+	for (auto pos : Test::Positions) {
+		const auto v = Test::GetElements(pos, ';');
+		Gigantua::Board brd(v[0]);
+		hashTest &= brd.status.WhiteMove() ? HashTest<true>(brd, 3) : HashTest<false>(brd, 3);
+	}
+
+	if (!hashTest) {
+		std::cout << "hash test ERROR!" << std::endl;
+		return 0;
+	}
+
+	std::cout << "hash test OK" << std::endl;
+
+	bool genTest = true;
+	for (auto pos : Test::Positions) {
+		const auto v = Test::GetElements(pos, ';');
+		Gigantua::Board brd(v[0]);
+		genTest &= brd.status.WhiteMove() ? GenModeTest<true>(brd) : GenModeTest<false>(brd);
+	}
+
+	if (!genTest) {
+		std::cout << "genmode test ERROR!" << std::endl;
+		return 0;
+	}
+
+	std::cout << "genmode test OK" << std::endl;
+
+	bool givesCheckTest = true;
+	for (auto pos : Test::Positions) {
+		const auto v = Test::GetElements(pos, ';');
+		Gigantua::Board brd(v[0]);
+		givesCheckTest &= brd.status.WhiteMove() ? GivesCheckTest<true>(brd, 3) : GivesCheckTest<false>(brd, 3);
+	}
+
+	if (!givesCheckTest) {
+		std::cout << "gives check test ERROR!" << std::endl;
+		return 0;
+	}
+
+	std::cout << "gives check test OK" << std::endl;
+
+	{
+		using namespace Gigantua::MoveList;
+		uint8_t from, to;
+		int8_t type;
+		Gigantua::Board seeBrd1("1k1r4/1pp4p/p7/4p3/8/P5P1/1PP4P/2K1R3 w - - 0 1");
+		Gigantua::Board seeBrd2("1k1r3q/1ppn3p/p4b2/4p3/8/P2N2P1/1PP1R1BP/2K1Q3 w - - 0 1");
+		Gigantua::Board::moveFromStr("e1e5", from, to, type);
+		const Gigantua::Board::Move<true> rxe5(from, to, Gigantua::MoveType::RookMove);
+		Gigantua::Board::moveFromStr("d3e5", from, to, type);
+		const Gigantua::Board::Move<true> nxe5(from, to, Gigantua::MoveType::KnightMove);
+
+		bool seeTest = SEE(seeBrd1, rxe5) == SeeValue[0] && SEE(seeBrd2, nxe5) < 0 && SEE_GE(seeBrd1, rxe5) && !SEE_GE(seeBrd2, nxe5);
+		for (auto pos : Test::Positions) {
+			const auto v = Test::GetElements(pos, ';');
+			Gigantua::Board brd(v[0]);
+			seeTest &= brd.status.WhiteMove() ? SeeTest<true>(brd) : SeeTest<false>(brd);
+		}
+
+		if (!seeTest) {
+			std::cout << "see test ERROR!" << std::endl;
+			return 0;
+		}
+
+		std::cout << "see test OK" << std::endl;
+	}
+
+	if (!FenTest()) {
+		std::cout << "fen test ERROR!" << std::endl;
+		return 0;
+	}
+
+	std::cout << "fen test OK" << std::endl;
+
+	if (!EpdTest()) {
+		std::cout << "epd test ERROR!" << std::endl;
+		return 0;
+	}
+
+	std::cout << "epd test OK" << std::endl;
+
+	if (!LookupTest()) {
+		std::cout << "lookup test ERROR!" << std::endl;
+		return 0;
+	}
+
+	std::cout << "lookup test OK" << std::endl;
+
+	if (!TTableTest()) {
+		std::cout << "tt test ERROR!" << std::endl;
+		return 0;
+	}
+
+	std::cout << "tt test OK" << std::endl;
+
 	{
 		Gigantua::Board ttt("rnbqkbnr/ppppp1pp/5p2/7Q/4P3/8/PPPP1PPP/RNB1KBNR b KQkq - 1 2");
 
@@ -126,6 +801,16 @@ int main(int argc, char** argv)
 
 	Chess_Test();
 
+	SpecializationPerfT("Start", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 6);
+	SpecializationPerfT("Kiwi", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 5);
+	LookupPerfT("Start", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 6);
+	LookupPerfT("Kiwi", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 5);
+	if (threadsNum > 1) {
+		ThreadsPerfT("Start", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 6);
+		ThreadsPerfT("Kiwi", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 5);
+	}
+	std::cout << "\n";
+
 	std::string_view def = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
 	std::string_view kiwi = "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1";
 	std::string_view midgame = "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10";
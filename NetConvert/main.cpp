@@ -0,0 +1,63 @@
+#include <iostream>
+#include <chrono>
+#include <fstream>
+#include <vector>
+#include <string>
+
+#include "../Eval/NeuroNetOpt.hpp"
+#include "../Gigantua/ChessTest.hpp"
+
+//Converts a genome text file (one float per line) into the binary net the engines map at startup:
+//NetConvert [genome0.txt] [genome0.bin] [64|32 king buckets]
+int main(int argc, char** argv) {
+	const char* textPath = argc > 1 ? argv[1] : "genome0.txt";
+	const char* binPath = argc > 2 ? argv[2] : "genome0.bin";
+	const uint32_t kingBuckets = argc > 3 && std::string(argv[3]) == "32" ? 32 : 64;
+
+	auto start = std::chrono::steady_clock::now();
+	const std::vector<float> genome = NN::NetFile::ReadGenome(textPath);
+	if (genome.empty()) {
+		std::cout << "cannot open " << textPath << std::endl;
+		return 1;
+	}
+
+	NN::NeuroNetOpt text;
+	NN::NetFile::Error error = text.SetGenome(genome, kingBuckets);
+	if (error != NN::NetFile::Error::None) {
+		std::cout << textPath << ": " << NN::NetFile::ErrorStr(error) << std::endl;
+		return 1;
+	}
+	auto parsed = std::chrono::steady_clock::now();
+
+	//Engines compare this against their genome0.txt and ignore a stale binary
+	error = text.Save(binPath, NN::NetFile::SourceOf(textPath));
+	if (error != NN::NetFile::Error::None) {
+		std::cout << binPath << ": " << NN::NetFile::ErrorStr(error) << std::endl;
+		return 1;
+	}
+
+	auto loadStart = std::chrono::steady_clock::now();
+	NN::NeuroNetOpt binary;
+	error = binary.Load(binPath, textPath);
+	auto loaded = std::chrono::steady_clock::now();
+	if (error != NN::NetFile::Error::None) {
+		std::cout << binPath << ": " << NN::NetFile::ErrorStr(error) << std::endl;
+		return 1;
+	}
+
+	//Round trip: both nets have to score every test position the same
+	size_t mismatches = 0;
+	for (const auto& pos : Test::Positions) {
+		const Gigantua::Board brd(Test::GetElements(pos, ';')[0]);
+		if (text.Evaluate(brd) != binary.Evaluate(brd)) mismatches++;
+	}
+
+	std::cout << textPath << ": " << genome.size() << " values in " << std::chrono::duration<double, std::milli>(parsed - start).count() << "ms" << std::endl;
+	std::cout << binPath << ": " << sizeof(NN::NetFile::Header) + NN::NeuroNetOpt::WeightsSize(binary.mKingBuckets) << " bytes, " << binary.mKingBuckets << " king buckets, loaded in " << std::chrono::duration<double, std::milli>(loaded - loadStart).count() << "ms" << std::endl;
+	if (mismatches) {
+		std::cout << "round trip ERROR! " << mismatches << " mismatches" << std::endl;
+		return 1;
+	}
+	std::cout << "round trip OK" << std::endl;
+	return 0;
+}
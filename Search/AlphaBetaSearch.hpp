@@ -6,6 +6,7 @@
 #include "TTable.hpp"
 #include "MoveCollector.hpp"
 #include "GameTree.hpp"
+#include "EvalStack.hpp"
 
 #include <thread>
 #include <functional>
@@ -75,9 +76,14 @@ namespace Search {
 				std::array<uint16_t, MaxSearchDepth> killerMove1 = {};
 				std::array<uint16_t, MaxSearchDepth> killerMove2 = {};
 				std::array<uint64_t, MaxSearchDepth> repetition = {};
+				std::shared_ptr<EvalStack> eval;
+				uint64_t nodes = 0;
+				TTable::Stats ttStats;
 
 				void Clear() {
 					ply = 0;
+					nodes = 0;
+					ttStats = {};
 					pvTable.Clear();
 					killerMove1.fill(0);
 					killerMove2.fill(0);
@@ -102,9 +108,20 @@ namespace Search {
 			PvLine currentBestLine;
 			int currentBestScore = 0;
 			std::function<float(const Gigantua::Board&)> m_costFunc;
+			EvalStackFactory m_evalFactory;
 			std::vector<SearchThread> searchThreads;
 			const GameTree* antTreePtr = nullptr;
 			std::array<uint64_t, 16> history;
+			uint64_t totalNodes = 0;
+			TTable::Stats totalTTStats;
+
+			//Folds a finished thread's counters into the totals
+			void Collect(SearchCtx& ctx) {
+				totalNodes += ctx.nodes;
+				totalTTStats += ctx.ttStats;
+				ctx.nodes = 0;
+				ctx.ttStats = {};
+			}
 
 			void ClearSearch()
 			{
@@ -115,6 +132,11 @@ namespace Search {
 				return m_costFunc(brd);
 			}
 
+			//Inside the tree - uses the thread's incremental stack
+			int Evaluate(SearchCtx& ctx, const Gigantua::Board& brd) const {
+				return ctx.eval->Evaluate(brd);
+			}
+
 			bool IsMateScore(int score) const {
 				return std::abs(score) > (MatVal - MaxSearchDepth);
 			}
@@ -197,6 +219,7 @@ namespace Search {
 
 			template<bool white>
 			int QuiescenceSearch(SearchCtx& ctx, const Gigantua::Board& pos, int alpha, int beta, int qply) {
+				ctx.nodes++;
 				if (ctx.ply >= MaxSearchDepth) return 0;
 				if (isDraw(pos)) return 0;
 
@@ -214,7 +237,7 @@ namespace Search {
 				if (!inCheck) {
 					if (alpha > MatVal - 100) return alpha;
 
-					stand_pat = Evaluate(pos);
+					stand_pat = Evaluate(ctx, pos);
 					if (stand_pat >= beta) return beta;
 					
 					if (stand_pat + 2900 < alpha) {
@@ -222,19 +245,32 @@ namespace Search {
 					}
 				}
 
+				//Past qply 4 quiets are never searched - skip generating them
 				MoveCollector<white> collector;
-				Gigantua::MoveList::EnumerateMoves<MoveCollector<white>, white>(collector, pos);
+				if (!inCheck && qply >= 4) {
+					Gigantua::MoveList::EnumerateMoves<MoveCollector<white>, white, Gigantua::MoveList::GenMode::Captures>(collector, pos);
+				}
+				else {
+					Gigantua::MoveList::EnumerateMoves<MoveCollector<white>, white>(collector, pos);
+				}
 
-				if (!inCheck) {
+				if (!inCheck && qply < 4) {
+					const Gigantua::MoveList::CheckInfo<white> checkInfo(pos);
+					for (uint8_t i = 0; i < collector.size; i++) {
+						const Gigantua::Board::Move<white> mv(collector.moves[i]);
+						collector.order[i] = SimpleSort(pos, checkInfo, mv);
+					}
+				}
+				else if (!inCheck) {
 					for (uint8_t i = 0; i < collector.size; i++) {
 						const Gigantua::Board::Move<white> mv(collector.moves[i]);
-						collector.order[i] = SimpleSort(pos, mv, qply >= 4);
+						collector.order[i] = CaptureSort(pos, mv);
 					}
 				}
 				else {
 					for (uint8_t i = 0; i < collector.size; i++) {
 						const Gigantua::Board::Move<white> mv(collector.moves[i]);
-						collector.order[i] = 10000 + SimpleSort(pos, mv, true);
+						collector.order[i] = 10000 + CaptureSort(pos, mv);
 					}
 				}
 
@@ -258,20 +294,27 @@ namespace Search {
 						}
 					}
 
+					const Gigantua::Board::Move<white> move(collector.moves[collector.index[i]]);
+
+					//Losing exchanges cannot raise alpha over stand pat - checks and queen promotions are kept
+					if (!inCheck && order < 3000 && !Gigantua::MoveList::SEE_GE(pos, move)) {
+						continue;
+					}
+
 					if (!inCheck && (order > 9000 || order < 100)) {
 						qply++;
 					}
-
-					const Gigantua::Board::Move<white> move(collector.moves[collector.index[i]]);
 					const auto next = move.play(pos);
 
 					ctx.ply++;
 					if (ctx.ply < MaxSearchDepth) {
 						ctx.repetition[ctx.ply] = next.Hash;
 					}
+					ctx.eval->Push(next);
 
 					int score = -QuiescenceSearch<!white>(ctx, next, -beta, -alpha, qply);
 
+					ctx.eval->Pop();
 					ctx.ply--;
 
 					if (score > alpha) {
@@ -304,6 +347,7 @@ namespace Search {
 					return QuiescenceSearch<white>(ctx, pos, alpha, beta, 0);
 				}
 
+				ctx.nodes++;
 				const bool rootNode = (ctx.ply == 0);
 
 				if (!rootNode) {
@@ -326,10 +370,11 @@ namespace Search {
 
 				const bool pvNode = (beta - alpha) > 1;
 				uint16_t bestMove = 0;
+				int16_t ttEval = TTable::NoEval;
 
 				// TT probe with improved cutoff
 				if (!rootNode) {
-					int cost = tTable.Get(pos, alpha, beta, depth, bestMove);
+					int cost = tTable.Get(pos, alpha, beta, depth, bestMove, ttEval, ctx.ttStats);
 					if (!pvNode && cost != TTable::NAN_VAL) {
 						return ScoreFromTT(cost, ctx.ply);
 					}
@@ -349,7 +394,9 @@ namespace Search {
 
 				bool futility = false;
 				if (myOrder < 200 && !pvNode && !inCheck && !rootNode) {
-					int staticEval = Evaluate(pos);
+					//Static eval is kept in the TT entry when it fits 16 bits
+					const int staticEval = ttEval != TTable::NoEval ? ttEval : Evaluate(ctx, pos);
+					if (staticEval > TTable::NoEval && staticEval <= std::numeric_limits<int16_t>::max()) ttEval = int16_t(staticEval);
 
 					int rfpMargin = 100 + 220 * depth;
 					if ((staticEval - rfpMargin) >= beta) {
@@ -377,11 +424,12 @@ namespace Search {
 					}
 				}
 
+				const Gigantua::MoveList::CheckInfo<white> checkInfo(pos);
 				for (uint8_t i = 0; i < collector.size; i++) {
 					const auto mcode = collector.moves[i];
 					const Gigantua::Board::Move<white> mv(mcode);
 					
-					int order = SimpleSort(pos, mv);
+					int order = SimpleSort(pos, checkInfo, mv);
 					
 					if (mcode == bestMove) order = 1000000;
 					else if (mcode == antMove) order += 2000000;
@@ -407,11 +455,17 @@ namespace Search {
 					const auto mcode = collector.moves[collector.index[m]];
 					const auto order = collector.order[collector.index[m]];
 					const auto next = move.play(pos);
+					//Children at depth 0 go to quiescence unless in check and never probe - no prefetch for them
+					if (depth > 1) {
+						tTable.Prefetch(next.Hash);
+						if (antTreePtr) antTreePtr->Prefetch(next.Hash);
+					}
 
 					ctx.ply++;
 					if (ctx.ply < MaxSearchDepth) {
 						ctx.repetition[ctx.ply] = next.Hash;
 					}
+					ctx.eval->Push(next);
 
 					int score = std::numeric_limits<int>::max();
 
@@ -438,6 +492,7 @@ namespace Search {
 						score = -MiniMaxAB<!white>(ctx, next, depth - 1, -beta, -alpha, order);
 					}
 
+					ctx.eval->Pop();
 					ctx.ply--;
 
 					if (score > bestScore) {
@@ -460,15 +515,19 @@ namespace Search {
 					}
 				}
 
-				tTable.Put(pos, ScoreToTT(alpha, ctx.ply), bestMove, depth, flag);
+				tTable.Put(pos, ScoreToTT(alpha, ctx.ply), bestMove, depth, flag, ttEval, ctx.ttStats);
 				return alpha;
 			}
 
 		public:
 
-			SearchEngine(std::function<float(const Gigantua::Board&)> costFunc, size_t ttSize = 2000000)
-				: tTable(ttSize), m_costFunc(costFunc)
+			//evalFactory gives each search thread its own incremental evaluation. Without it costFunc is called per node
+			SearchEngine(std::function<float(const Gigantua::Board&)> costFunc, size_t ttSize = 2000000, EvalStackFactory evalFactory = nullptr)
+				: tTable(ttSize), m_costFunc(costFunc), m_evalFactory(evalFactory)
 			{
+				if (!m_evalFactory) {
+					m_evalFactory = [costFunc]() { return std::make_shared<CostFuncEvalStack>(costFunc); };
+				}
 			}
 
 			~SearchEngine()
@@ -505,11 +564,14 @@ namespace Search {
 				SearchCtx ctx;
 				ctx.Clear();
 				ctx.repetition[0] = current.Hash;
+				ctx.eval = m_evalFactory();
+				ctx.eval->Reset(current);
 
 				searchStarted = true;
 				int score = MiniMaxAB<white>(ctx, current, depth, -1000000, 1000000);
 				searchStarted = false;
 				bestMove = ctx.pvTable.GetBest().line[0];
+				Collect(ctx);
 				return score;
 			}
 
@@ -520,7 +582,7 @@ namespace Search {
 				std::function<void(uint16_t)> onWin = nullptr)
 			{
 				Stop();
-				ClearSearch();
+				tTable.NewSearch();
 
 				{
 					const auto mv = Gigantua::MoveList::MoveList<white>(current);
@@ -543,6 +605,7 @@ namespace Search {
 				for (uint16_t i = 0; i < threadsNum; i++) {
 					SearchThread st;
 					st.ctx.Clear();
+					st.ctx.eval = m_evalFactory();
 					searchThreads.push_back(std::move(st));
 				}
 
@@ -555,6 +618,7 @@ namespace Search {
 							depth++;
 							Gigantua::Board pos = current;
 							searchThreads[i].ctx.repetition[0] = pos.Hash;
+							searchThreads[i].ctx.eval->Reset(pos);
 							const auto startTime = std::chrono::high_resolution_clock::now();
 
 							int alpha = -MatVal;
@@ -569,7 +633,7 @@ namespace Search {
 								if (searchThreads[i].ctx.pvTable.GetBest().size > 0) {
 									currentBestScore = score;
 									currentBestLine = searchThreads[i].ctx.pvTable.GetBest();
-									std::cout << "d" << int(depth) << "s" << score << "ms" << dur_ms.count() << "(" << Gigantua::Board::moveStr(currentBestLine.line[0]) << ")" << std::endl;
+									std::cout << "d" << int(depth) << "s" << score << "ms" << dur_ms.count() << "(" << Gigantua::Board::moveStr(currentBestLine.line[0]) << ")hf" << tTable.HashFull() << std::endl;
 								}
 
 								if (IsMateScore(score)) {
@@ -602,14 +666,30 @@ namespace Search {
 				return true;
 			}
 
+			//Forget the previous game - StartSearch keeps the table and only ages it
+			void NewGame() {
+				Stop();
+				ClearSearch();
+			}
+
 			void Stop() {
 				searchStarted = false;
 				for (auto& t : searchThreads) {
 					t.Wait();
+					Collect(t.ctx);
 				}
 			}
 
 			uint16_t GetBestMoveTT(const Gigantua::Board& brd) const { return tTable.GetBestMove(brd); }
+			std::array<uint32_t, TTable::Generations> HashFullByAge() const { return tTable.HashFullByAge(); }
+
+			//Counters of finished searches since the last ResetStats
+			uint64_t Nodes() const { return totalNodes; }
+			TTable::Stats TTStats() const { return totalTTStats; }
+			void ResetStats() {
+				totalNodes = 0;
+				totalTTStats = {};
+			}
 			PvLine GetBestLine() const { return currentBestLine; }
 			uint16_t BestMove() const { return currentBestLine.size > 0 ? currentBestLine.line[0] : 0; }
 			int BestScore() const { return currentBestScore; }
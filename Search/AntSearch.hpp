@@ -65,6 +65,7 @@ namespace Ant {
 
 			static constexpr uint8_t MaxPath = 64;
 			std::array<Step, MaxPath> path;
+			std::shared_ptr<EvalStack> eval;
 			std::array<float, 256> probList;
 
 			inline uint8_t peekRnd(std::array<float, 256>& list, size_t size)
@@ -106,6 +107,7 @@ namespace Ant {
 		std::vector<SearchThread> m_threads;
 
 		std::function<float(const Gigantua::Board&)> m_costFunc;
+		EvalStackFactory m_evalFactory;
 
 		static constexpr float MatVal = 10000.0f;
 
@@ -138,9 +140,10 @@ namespace Ant {
 				coll.Reset();
 				Gigantua::MoveList::EnumerateMoves<MoveCollector<MoveWhite>, MoveWhite>(coll, position);
 
+				const Gigantua::MoveList::CheckInfo<MoveWhite> checkInfo(position);
 				for (uint8_t i = 0; i < coll.size; i++) {
 					const Gigantua::Board::Move<MoveWhite> move(coll.moves[i]);
-					coll.order[i] = SimpleSort(position, move);
+					coll.order[i] = SimpleSort(position, checkInfo, move);
 				}
 
 				coll.SortMoves();
@@ -229,6 +232,8 @@ namespace Ant {
 
 			const Gigantua::Board::Move<MoveWhite> currMove(edges[moveIndex].Move());
 			position = currMove.play(position);
+			m_searchTree.Prefetch(position.Hash);
+			ctx.eval->Push(position);
 			nodePtr.Unlock();
 
 			// common repetition / loop detection against global history
@@ -265,6 +270,7 @@ namespace Ant {
 			AntStepResult stepResult = AntStepResult::EndPath;
 			std::array<uint64_t, SearchContext::MaxPath> repetition = { 0 };
 			repetition[ply] = position.Hash;
+			ctx.eval->Reset(position);
 			while (ply < SearchContext::MaxPath - 2) {
 				// first move: this is "my" move when RunAnt<white> and DoStep<white, true>
 				{
@@ -297,9 +303,9 @@ namespace Ant {
 				else if (position.status.WhiteMove() != white && Gigantua::MoveList::InCheck<!white>(position))
 					cost = 10;
 				else if (white == position.status.WhiteMove())
-					cost = m_costFunc(position);
+					cost = ctx.eval->Evaluate(position);
 				else
-					cost = -m_costFunc(position);
+					cost = -ctx.eval->Evaluate(position);
 
 			}
 
@@ -332,9 +338,13 @@ namespace Ant {
 		}
 
 	public:
-		Engine(std::function<float(const Gigantua::Board&)> costFunc, size_t treeSize = 1000000, size_t ab_tt_size = 4000000)
-			: m_costFunc(costFunc), m_searchTree(treeSize), m_abEngine(costFunc, ab_tt_size)
+		//evalFactory is shared with the alpha-beta engine - see AlphaBeta::SearchEngine
+		Engine(std::function<float(const Gigantua::Board&)> costFunc, size_t treeSize = 1000000, size_t ab_tt_size = 4000000, EvalStackFactory evalFactory = nullptr)
+			: m_costFunc(costFunc), m_evalFactory(evalFactory), m_searchTree(treeSize), m_abEngine(costFunc, ab_tt_size, evalFactory)
 		{
+			if (!m_evalFactory) {
+				m_evalFactory = [costFunc]() { return std::make_shared<CostFuncEvalStack>(costFunc); };
+			}
 			Set(Gigantua::Board::StartPosition());
 		}
 
@@ -349,6 +359,11 @@ namespace Ant {
 			m_current = brd;
 		}
 
+		void NewGame() {
+			Stop();
+			m_abEngine.NewGame();
+		}
+
 		void SetHistory(const std::array<uint64_t, 16>& h) {
 			m_abEngine.SetHistory(h);
 			history = h;
@@ -376,6 +391,7 @@ namespace Ant {
 			m_threads.resize(threadNumber);
 
 			for (uint8_t i = 0; i < threadNumber; i++) {
+				if (!m_threads[i].ctx.eval) m_threads[i].ctx.eval = m_evalFactory();
 				m_threads[i].started = true;
 				m_threads[i].thread.reset(new std::thread([this, i]() {
 					size_t maxAnt = 0;
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "../Gigantua/ChessBase.hpp"
+
+#include <functional>
+#include <memory>
+#include <array>
+#include <assert.h>
+
+namespace Search {
+
+	//Evaluation that follows the search path. Every search thread owns one.
+	//Reset at the root, Push after Board::Move::play, Pop when the move is taken back. Evaluate scores the board on top
+	class EvalStack {
+	public:
+		virtual ~EvalStack() = default;
+		virtual void Reset(const Gigantua::Board& root) = 0;
+		virtual void Push(const Gigantua::Board& next) = 0;
+		virtual void Pop() = 0;
+		virtual float Evaluate(const Gigantua::Board& brd) = 0;
+	};
+
+	using EvalStackFactory = std::function<std::shared_ptr<EvalStack>()>;
+
+	//Plain cost function - nothing to keep per ply
+	class CostFuncEvalStack : public EvalStack {
+	private:
+		std::function<float(const Gigantua::Board&)> m_costFunc;
+	public:
+		CostFuncEvalStack(std::function<float(const Gigantua::Board&)> costFunc) : m_costFunc(costFunc) {}
+
+		void Reset(const Gigantua::Board&) override {}
+		void Push(const Gigantua::Board&) override {}
+		void Pop() override {}
+		float Evaluate(const Gigantua::Board& brd) override { return m_costFunc(brd); }
+	};
+
+	//Accumulator per ply for nets with Accumulator, RefreshCache, Refresh, Update and Evaluate(brd, acc) - see NN::NeuroNetEval.
+	//The refresh cache is only valid for the weights it was built with - make new stacks after changing the net.
+	//Push only records the board. The accumulator is brought up to date from the nearest computed ply when Evaluate
+	//needs it, so plies that are never evaluated cost nothing
+	template<class TNet>
+	class AccumulatorEvalStack : public EvalStack {
+	private:
+		static constexpr size_t MaxPly = 128;
+		static constexpr size_t RefreshGap = 8;
+
+		struct Entry {
+			Gigantua::Board board;
+			typename TNet::Accumulator acc;
+			bool computed = false;
+		};
+
+		TNet& m_net;
+		typename TNet::RefreshCache m_cache;
+		std::array<Entry, MaxPly> m_stack;
+		size_t m_top = 0;
+
+	public:
+		AccumulatorEvalStack(TNet& net) : m_net(net) {}
+
+		void Reset(const Gigantua::Board& root) override {
+			m_top = 0;
+			m_stack[0].board = root;
+			m_stack[0].computed = false;
+		}
+
+		void Push(const Gigantua::Board& next) override {
+			assert(m_top + 1 < MaxPly);
+			m_top++;
+			m_stack[m_top].board = next;
+			m_stack[m_top].computed = false;
+		}
+
+		void Pop() override {
+			assert(m_top > 0);
+			m_top--;
+		}
+
+		float Evaluate(const Gigantua::Board& brd) override {
+			assert(brd == m_stack[m_top].board);
+
+			size_t base = m_top;
+			while (base > 0 && !m_stack[base].computed) base--;
+
+			//A long unevaluated stretch (ant playouts) is cheaper to rebuild than to replay
+			if (m_top - base > RefreshGap || !m_stack[base].computed) {
+				if (m_top - base > RefreshGap) base = m_top;
+				m_net.Refresh(m_stack[base].acc, m_stack[base].board, m_cache);
+				m_stack[base].computed = true;
+			}
+
+			for (size_t i = base + 1; i <= m_top; i++) {
+				m_net.Update(m_stack[i - 1].acc, m_stack[i].acc, m_stack[i - 1].board, m_stack[i].board, m_cache);
+				m_stack[i].computed = true;
+			}
+
+			return m_net.Evaluate(brd, m_stack[m_top].acc);
+		}
+	};
+
+}//namespace Search
@@ -3,8 +3,10 @@
 #include <array>
 #include <vector>
 #include <atomic>
+#include <xmmintrin.h>
 
 #include <../Gigantua/ChessBase.hpp>
+#include <../Gigantua/LargePages.hpp>
 
 namespace Search {
 
@@ -152,7 +154,7 @@ namespace Search {
 		};
 
 		typedef std::array<Node, BucketSize> Bucket;
-		typedef std::vector<Bucket> HashTable;
+		typedef std::vector<Bucket, LargePages::Allocator<Bucket>> HashTable;
 
 		HashTable hashTable;
 		mutable uint64_t time = 1;
@@ -161,6 +163,13 @@ namespace Search {
 		GameTree(size_t size) : HashTableSize(size / BucketSize), hashTable(HashTableSize), Size(size) {
 		}
 
+		//First node of the bucket - Get scans it front to back, the hardware prefetcher follows from there
+		void Prefetch(uint64_t hash) const {
+			const char* node = (const char*)&hashTable[hash % HashTableSize][0];
+			_mm_prefetch(node, _MM_HINT_T0);
+			_mm_prefetch(node + 64, _MM_HINT_T0);
+		}
+
 		NodePtr Get(const Gigantua::Board& brd) {
 			Bucket& bucket = hashTable[brd.Hash % HashTableSize];
 
@@ -74,8 +74,9 @@ namespace Search {
 
 	static constexpr std::array<int32_t, 7> capOrder = { 136, 782, 830, 1289, 2529, 0, 0 };
 
+	//Captures and queen promotions only
 	template<bool white>
-	static int32_t SimpleSort(const Gigantua::Board& pos, const Gigantua::Board::Move<white> move, bool onlyCap = false)
+	static int32_t CaptureSort(const Gigantua::Board& pos, const Gigantua::Board::Move<white> move)
 	{
 		int32_t result = capOrder[int(move.captured(pos))];
 
@@ -88,17 +89,23 @@ namespace Search {
 
 		if (move.isQueenPromote()) result += 3000;
 
-		if (onlyCap) return result;
+		return result;
+	}
+
+	//checkInfo is built once per node - moves are scored without playing them
+	template<bool white>
+	static int32_t SimpleSort(const Gigantua::Board& pos, const Gigantua::MoveList::CheckInfo<white>& checkInfo, const Gigantua::Board::Move<white> move)
+	{
+		int32_t result = CaptureSort(pos, move);
 
-		const auto next = move.play(pos);
-		if (Gigantua::MoveList::InCheck<!white>(next)) result += 10000;
+		if (checkInfo.GivesCheck(move)) result += 10000;
 
 		if (result)
 			return result;
 
-		const auto skipNext = pos.SkipMove();
+		const Gigantua::BoardPiece threat = checkInfo.Threat(move);
 
-		if (!Gigantua::MoveList::QueenInCheck<!white>(skipNext) && Gigantua::MoveList::QueenInCheck<!white>(next)) {
+		if (threat == Gigantua::BoardPiece::Queen) {
 			result += 90;
 			if (move.who(pos) == Gigantua::BoardPiece::Pawn) result += 5;
 			if (move.who(pos) == Gigantua::BoardPiece::Knight) result += 3;
@@ -107,7 +114,7 @@ namespace Search {
 			return result;
 		}
 
-		if (!Gigantua::MoveList::RookInCheck<!white>(skipNext) && Gigantua::MoveList::RookInCheck<!white>(next)) {
+		if (threat == Gigantua::BoardPiece::Rook) {
 			result += 80;
 			if (move.who(pos) == Gigantua::BoardPiece::Pawn) result += 5;
 			if (move.who(pos) == Gigantua::BoardPiece::Knight) result += 3;
@@ -115,7 +122,7 @@ namespace Search {
 			return result;
 		}
 
-		if (!Gigantua::MoveList::KnightInCheck<!white>(skipNext) && Gigantua::MoveList::KnightInCheck<!white>(next)) {
+		if (threat == Gigantua::BoardPiece::Knight) {
 			result += 70;
 			if (move.who(pos) == Gigantua::BoardPiece::Pawn) result += 5;
 			if (move.who(pos) == Gigantua::BoardPiece::Bishop) result += 2;
@@ -123,7 +130,7 @@ namespace Search {
 			return result;
 		}
 
-		if (!Gigantua::MoveList::BishopInCheck<!white>(skipNext) && Gigantua::MoveList::BishopInCheck<!white>(next)) {
+		if (threat == Gigantua::BoardPiece::Bishop) {
 			result += 60;
 			if (move.who(pos) == Gigantua::BoardPiece::Pawn) result += 5;
 			if (move.who(pos) == Gigantua::BoardPiece::Knight) result += 2;
@@ -3,8 +3,11 @@
 #include <array>
 #include <vector>
 #include <limits>
+#include <xmmintrin.h>
 
 #include <../Gigantua/ChessBase.hpp>
+#include <../Gigantua/MoveList.hpp>
+#include <../Gigantua/LargePages.hpp>
 
 namespace Search {
 
@@ -18,11 +21,19 @@ namespace Search {
 		};
 
 		static constexpr int NAN_VAL = 0x7fffffff;
+		static constexpr int16_t NoEval = std::numeric_limits<int16_t>::min();
 
+		//16 bytes, no board. smpData packs score, move, depth, flag and generation. smpKey holds the upper 32 bits of the
+		//hash and the static eval, xored with smpData - a half written entry from another thread fails the key check.
+		//The bucket comes from the hash modulo the table size, so the two together verify ~52 bits. Scores of entries
+		//with a move are only trusted once the move is legal in the probed position
 		struct Node {
-			Gigantua::Board brd;
 			uint64_t smpKey = 0ull;
-			uint64_t smpData = NAN_VAL;
+			uint64_t smpData = 0ull;
+
+			static uint64_t KeyOf(uint64_t hash) {
+				return hash & 0xFFFFFFFF00000000ull;
+			}
 
 			int ExtractScore() const {
 				const uint32_t scoreData = (smpData & 0x00000000FFFFFFFFull);
@@ -38,15 +49,19 @@ namespace Search {
 			}
 
 			Flag ExtractFlag() const {
-				return (Flag)((smpData & 0xFF00000000000000ull) >> 56);
+				return (Flag)((smpData & 0x0300000000000000ull) >> 56);
 			}
 
-			static uint64_t PackData(int score, uint16_t move, uint8_t depth, Flag flag) {
+			uint8_t ExtractGeneration() const {
+				return (uint8_t)((smpData & 0xFC00000000000000ull) >> 58);
+			}
+
+			static uint64_t PackData(int score, uint16_t move, uint8_t depth, Flag flag, uint8_t generation) {
 				const int s = score;
 				const uint64_t scoreData = *(uint32_t*)(&s);
 				const uint64_t moveData = move;
 				const uint64_t depthData = depth;
-				const uint64_t flagData = (uint8_t)flag;
+				const uint64_t flagData = (uint8_t)flag | uint8_t(generation << 2);
 
 				uint64_t data = scoreData;
 				data |= moveData << 32;
@@ -56,101 +71,208 @@ namespace Search {
 				return data;
 			}
 
+			static uint64_t PackKey(uint64_t hash, int16_t eval) {
+				return KeyOf(hash) | (uint64_t(uint16_t(eval)) << 16);
+			}
 		};
+		static_assert(sizeof(Node) == 16, "four nodes per cache line");
 
-		static constexpr uint8_t BucketSize = 2;
+		static constexpr uint8_t BucketSize = 4;
+		static constexpr uint8_t Generations = 64;
+		//Depth a slot loses per search it has not been written in
+		static constexpr int AgeWeight = 4;
+		//Buckets sampled for the hashfull statistic - 1000 entries, so counts are per mille
+		static constexpr size_t SampleBuckets = 250;
 
-		typedef std::array<Node, BucketSize> Bucket;
+		struct alignas(64) Bucket : std::array<Node, BucketSize> {};
+		static_assert(sizeof(Bucket) == 64, "one bucket per cache line");
 
-		typedef std::vector<Bucket> HashTable;
+		typedef std::vector<Bucket, LargePages::Allocator<Bucket>> HashTable;
 
 		mutable HashTable hashTable;
+		uint8_t generation = 0; //6 bits
 
-		TTable(size_t size) : HashTableSize(size / BucketSize), hashTable(HashTableSize) {
+		//size in entries - 16 bytes each
+		TTable(size_t size) : HashTableSize(std::max<size_t>(size / BucketSize, 1)), hashTable(HashTableSize) {
 		}
 
+		//New game only - between searches NewSearch ages the entries instead
 		void Clear() {
 			static Bucket empty;
 			std::fill(hashTable.begin(), hashTable.end(), empty);
+			generation = 0;
+		}
+
+		void NewSearch() {
+			generation = (generation + 1) & (Generations - 1);
+		}
+
+		//Searches since the node was written
+		uint8_t Age(const Node& node) const {
+			return (generation - node.ExtractGeneration()) & (Generations - 1);
+		}
+
+		//Used entries of the sample by age, index 0 is the current search
+		std::array<uint32_t, Generations> HashFullByAge() const {
+			std::array<uint32_t, Generations> result = {};
+			const size_t buckets = std::min(SampleBuckets, HashTableSize);
+			for (size_t b = 0; b < buckets; b++) {
+				for (const Node& node : hashTable[b]) {
+					if (node.ExtractDepth() != 0) result[Age(node)]++;
+				}
+			}
+			return result;
+		}
+
+		//Per mille of the sample written by the current search, as uci hashfull
+		uint32_t HashFull() const {
+			return HashFullByAge()[0];
+		}
+
+		//Issue as soon as the child hash is known, the bucket load then overlaps the make move and eval update
+		void Prefetch(uint64_t hash) const {
+			_mm_prefetch((const char*)&hashTable[hash % HashTableSize], _MM_HINT_T0);
+		}
+
+		//Key and eval of a consistent copy of the node or false when it belongs to another position
+		static bool Read(const Node& node, uint64_t hash, uint64_t& data, int16_t& eval) {
+			data = node.smpData;
+			const uint64_t key = node.smpKey ^ data;
+			if ((key & 0xFFFFFFFF00000000ull) != Node::KeyOf(hash)) return false;
+			eval = int16_t((key >> 16) & 0xFFFF);
+			return true;
+		}
+
+		//No move (fail low, mate, stalemate) leaves only the hash to go by
+		static bool IsLegal(const Gigantua::Board& brd, uint16_t move) {
+			if (move == 0) return true;
+			if (brd.status.WhiteMove()) return Gigantua::MoveList::IsLegal<true>(brd, move);
+			return Gigantua::MoveList::IsLegal<false>(brd, move);
 		}
 
 		uint16_t GetBestMove(const Gigantua::Board& brd) const {
 			const Bucket& bucket = hashTable[brd.Hash % HashTableSize];
 			for(size_t i = 0; i < BucketSize; i++) {
-				const Node& node = bucket[i];
-				const uint64_t testKey = brd.Hash ^ node.smpData;
-				if (testKey == node.smpKey && node.ExtractFlag() == Flag::Value && node.brd == brd) {
+				Node node;
+				int16_t eval;
+				if (Read(bucket[i], brd.Hash, node.smpData, eval) && node.ExtractFlag() == Flag::Value && node.ExtractMove() && IsLegal(brd, node.ExtractMove())) {
 					return node.ExtractMove();
 				}
 			}
-			return 0;	
+			return 0;
 		}
 
-		int Get(const Gigantua::Board& brd, int alpha, int beta, uint8_t depth, uint16_t& bestMove) const {
+		//Probe and store outcomes. Kept per search thread and summed by the engine
+		struct Stats {
+			uint64_t probes = 0;
+			uint64_t hits = 0;
+			uint64_t cutoffs = 0;
+			uint64_t overwrites = 0; //live entries of other positions replaced
+
+			Stats& operator+=(const Stats& other) {
+				probes += other.probes;
+				hits += other.hits;
+				cutoffs += other.cutoffs;
+				overwrites += other.overwrites;
+				return *this;
+			}
+		};
+
+		//staticEval is NoEval unless the entry carries one. Put keeps one entry per position, so the first match is it
+		int Get(const Gigantua::Board& brd, int alpha, int beta, uint8_t depth, uint16_t& bestMove, int16_t& staticEval, Stats& stats) const {
+			staticEval = NoEval;
+			stats.probes++;
 			Bucket& bucket = hashTable[brd.Hash % HashTableSize];
 			for (size_t i = 0; i < BucketSize; i++) {
-				Node& node = bucket[i];
-				const uint64_t testKey = brd.Hash ^ node.smpData;
-				if (testKey == node.smpKey && node.brd == brd) {
-					bestMove = node.ExtractMove();
-
-					if (node.ExtractDepth() >= depth) {
-						int score = node.ExtractScore();
-
-						switch (node.ExtractFlag()) {
-						case Flag::Value:
-							return score;
-						case Flag::Alpha:
-						{
-							if (score <= alpha) return alpha;
-							break;
-						}
-						case Flag::Beta:
-						{
-							if (score >= beta) return beta;
-							break;
-						}
-						default:
-							break;
-						}
+				Node node;
+				int16_t eval;
+				if (!Read(bucket[i], brd.Hash, node.smpData, eval)) continue;
+
+				//An illegal move only never matches in move ordering, a cutoff needs the legality check
+				stats.hits++;
+				bestMove = node.ExtractMove();
+				staticEval = eval;
+
+				if (node.ExtractDepth() >= depth) {
+					int score = node.ExtractScore();
+					int result = NAN_VAL;
+
+					switch (node.ExtractFlag()) {
+					case Flag::Value:
+						result = score;
+						break;
+					case Flag::Alpha:
+						if (score <= alpha) result = alpha;
+						break;
+					case Flag::Beta:
+						if (score >= beta) result = beta;
+						break;
+					default:
+						break;
+					}
+
+					if (result != NAN_VAL && IsLegal(brd, bestMove)) {
+						stats.cutoffs++;
+						return result;
 					}
 				}
 				break;
 			}
-			
+
 			return NAN_VAL;
 		}
 
-		void Put(const Gigantua::Board& brd, int cost, uint16_t bestMove, uint8_t depth, Flag flag) {
+		//Same position: the deeper entry stays, a deeper one from an old search only gets the current generation.
+		//Otherwise the slot with the lowest depth - AgeWeight * age goes, empty slots first
+		void Put(const Gigantua::Board& brd, int cost, uint16_t bestMove, uint8_t depth, Flag flag, int16_t staticEval, Stats& stats) {
 			Bucket& bucket = hashTable[brd.Hash % HashTableSize];
 
-			uint8_t minDepth = 255;
+			int minWorth = std::numeric_limits<int>::max();
 			uint8_t minIndex = 0;
+			bool found = false;
 
 			for (uint8_t i = 0; i < BucketSize; i++) {
 				Node& node = bucket[i];
 
-				if (node.smpKey != 0) {
-					if (node.brd == brd && node.ExtractDepth() > depth)
+				uint64_t data;
+				int16_t eval;
+				if (node.smpKey != 0 && Read(node, brd.Hash, data, eval)) {
+					const Node old{ 0, data };
+					if (old.ExtractDepth() > depth) {
+						if (Age(old) != 0) {
+							node.smpData = Node::PackData(old.ExtractScore(), old.ExtractMove(), old.ExtractDepth(), old.ExtractFlag(), generation);
+							node.smpKey = Node::PackKey(brd.Hash, eval) ^ node.smpData;
+						}
 						return;
+					}
+					if (staticEval == NoEval) staticEval = eval;
+					minIndex = i;
+					found = true;
+					break;
 				}
 
+				//First empty slot, but keep looking for the position itself
 				if (node.ExtractDepth() == 0) {
-					minIndex = i;
-					break;
+					if (minWorth != std::numeric_limits<int>::min()) {
+						minWorth = std::numeric_limits<int>::min();
+						minIndex = i;
+					}
+					continue;
 				}
 
-				if (bucket[i].ExtractDepth() < minDepth) {
-					minDepth = bucket[i].ExtractDepth();
+				//Deep entries from old searches go before shallow ones from this search
+				const int worth = int(node.ExtractDepth()) - AgeWeight * Age(node);
+				if (worth < minWorth) {
+					minWorth = worth;
 					minIndex = i;
 				}
 			}
 
-			bucket[minIndex].brd = brd;
-			bucket[minIndex].smpData = Node::PackData(cost, bestMove, depth, flag);
-			bucket[minIndex].smpKey = brd.Hash ^ bucket[minIndex].smpData;
+			if (!found && bucket[minIndex].ExtractDepth() != 0) stats.overwrites++;
+
+			bucket[minIndex].smpData = Node::PackData(cost, bestMove, depth, flag, generation);
+			bucket[minIndex].smpKey = Node::PackKey(brd.Hash, staticEval) ^ bucket[minIndex].smpData;
 		}
 	};
 
 }
-